@@ -0,0 +1,3967 @@
+/*
+base256
+
+Copyright (c) 2019, Lode Vandevenne
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef BASE256_H_
+#define BASE256_H_
+
+// The formats and the Printer of base256, as a header-only library: include
+// it from any amount of source files and build with -pthread. Base256Codec
+// at the end encodes and decodes between buffers of the caller.
+
+#include <algorithm>
+#include <cassert>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+// On x86 the SIMD kernels are compiled for every instruction set with target
+// attributes, whatever the compiler flags, and chosen at run time, see
+// simd_kernel.
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define BASE256_X86
+#include <immintrin.h>
+#define TARGET_SSE42 __attribute__((target("sse4.2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_AVX512 __attribute__((target("avx2,avx512f,avx512bw")))
+#endif
+
+// amount of bytes read from the input at once when streaming, and written to
+// the output at once
+static const size_t BLOCK_SIZE = 262144;
+
+// Instruction sets that the SIMD kernels are made for, each one including the
+// ones before it. Kernels that have no version for a set use the one for the
+// set before it.
+enum Kernel {
+  KERNEL_SCALAR,
+  KERNEL_SSE42, // SSE2 up to SSE4.2, the kernels use up to SSE4.1
+  KERNEL_AVX2,
+  KERNEL_AVX512, // AVX-512F and BW
+  NUM_KERNELS
+};
+
+static const char* const KERNEL_NAMES[NUM_KERNELS] = {"scalar", "sse4.2", "avx2", "avx512"};
+
+// the best kernel that the CPU supports, detected with cpuid
+inline Kernel detect_kernel() {
+#if defined(BASE256_X86)
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) return KERNEL_AVX512;
+  if(__builtin_cpu_supports("avx2")) return KERNEL_AVX2;
+  if(__builtin_cpu_supports("sse4.2")) return KERNEL_SSE42;
+#endif
+  return KERNEL_SCALAR;
+}
+
+// The kernel in use, which is the best one of the CPU, detected on first use.
+// May be set to a lower one, for testing and benchmarking, but not while
+// encoding or decoding.
+inline Kernel& simd_kernel() {
+  static Kernel kernel = detect_kernel();
+  return kernel;
+}
+
+// Sets simd_kernel by its name in KERNEL_NAMES. Returns false if the name is
+// unknown or the CPU doesn't support it.
+inline bool set_kernel(const std::string& name) {
+  for(int k = 0; k < NUM_KERNELS; k++) {
+    if(name != KERNEL_NAMES[k]) continue;
+    if(k > detect_kernel()) return false;
+    simd_kernel() = (Kernel)k;
+    return true;
+  }
+  return false;
+}
+
+#if defined(BASE256_X86)
+// The 128 bits of v in all four lanes. _mm512_broadcast_i32x4 does the same,
+// but makes GCC 12 warn about an uninitialized variable with -Wall, which the
+// zero masking form with every lane enabled doesn't.
+TARGET_AVX512 static inline __m512i broadcast_lanes(__m128i v) {
+  return _mm512_maskz_broadcast_i32x4((__mmask16)-1, v);
+}
+
+// lane K of v, like _mm512_extracti32x4_epi32 but without its warning
+template<int K>
+TARGET_AVX512 static inline __m128i extract_lane(__m512i v) {
+  return _mm512_maskz_extracti32x4_epi32((__mmask8)-1, v, K);
+}
+#endif
+
+// Reads up to size bytes from the file descriptor, retrying if interrupted by
+// a signal. Returns the amount of bytes read, 0 at the end, or -1 on error.
+inline ssize_t read_block(int fd, char* buffer, size_t size) {
+  for(;;) {
+    ssize_t result = read(fd, buffer, size);
+    if(result >= 0 || errno != EINTR) return result;
+  }
+}
+
+// An input file that is memory mapped when possible, so that it can be used
+// without copying. Files that can't be mapped, such as those under /proc
+// (which report size 0) are read into memory instead.
+class InputFile {
+ public:
+  ~InputFile() {
+    if(map) munmap(map, mapsize);
+    if(fd > 0) close(fd);
+  }
+
+  // Opens the named file, or stdin if the name is empty. Stdin is only loaded
+  // if it is a regular file (e.g. redirected with <), otherwise it is left to
+  // stream from or to readAll. With a range, only the bytes from offset (or
+  // if negative, that many before the end) up to length bytes (all if
+  // negative) are loaded. Returns false on error.
+  bool open(const std::string& filename, int64_t offset = 0, int64_t length = -1) {
+    fd = filename.empty() ? 0 : ::open(filename.c_str(), O_RDONLY);
+    if(fd < 0) return false;
+    struct stat st;
+    if(fstat(fd, &st) != 0) return false;
+    bool range = offset != 0 || length >= 0;
+    if(S_ISREG(st.st_mode) && st.st_size > 0) {
+      size_t begin, end;
+      getRange(st.st_size, offset, length, &begin, &end);
+      start = begin;
+      if(range) return readRange(end - begin);
+      void* p = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if(p != MAP_FAILED) {
+        map = p;
+        mapsize = st.st_size;
+        madvise(map, mapsize, MADV_SEQUENTIAL);
+        loaded = true;
+        return true;
+      }
+    }
+    if(range) {
+      // not seekable, or of unknown size like in /proc: read up to the end of
+      // the range and cut it out
+      if(offset >= 0 && length >= 0) limit = offset + length;
+      if(!readAll()) return false;
+      size_t begin, end;
+      getRange(buffer.size(), offset, length, &begin, &end);
+      buffer = buffer.substr(begin, end - begin);
+      start = begin;
+      return true;
+    }
+    if(!filename.empty() || S_ISREG(st.st_mode)) return readAll();
+    return true;
+  }
+
+  // reads everything from the file into memory, for when it can't be mapped
+  bool readAll() {
+    std::string block(BLOCK_SIZE, 0);
+    ssize_t n = 0;
+    while(buffer.size() < limit && (n = read_block(fd, &block[0], block.size())) > 0) {
+      buffer.append(block, 0, n);
+    }
+    loaded = true;
+    return buffer.size() >= limit || n == 0;
+  }
+
+  const char* data() const {
+    return map ? (const char*)map : buffer.data();
+  }
+
+  size_t size() const {
+    return map ? mapsize : buffer.size();
+  }
+
+  int fd = -1;
+  bool loaded = false; // whether data() has the whole input
+  size_t start = 0; // offset in the file of the first byte of data()
+
+ private:
+  // the range [begin, end) of a file of the given size, clamped to its bounds
+  static void getRange(size_t size, int64_t offset, int64_t length, size_t* begin, size_t* end) {
+    *begin = offset < 0 ? size - std::min<size_t>(-offset, size) : std::min<size_t>(offset, size);
+    *end = length < 0 ? size : *begin + std::min<size_t>(length, size - *begin);
+  }
+
+  // reads size bytes at start with pread, leaving the rest of the file alone
+  bool readRange(size_t size) {
+    buffer.resize(size);
+    size_t pos = 0;
+    while(pos < size) {
+      ssize_t n = pread(fd, &buffer[pos], size - pos, start + pos);
+      if(n < 0 && errno == EINTR) continue;
+      if(n <= 0) break;
+      pos += n;
+    }
+    buffer.resize(pos);
+    loaded = true;
+    return pos == size;
+  }
+
+  size_t limit = (size_t)-1; // stop reading at this size, when only a range is needed
+  void* map = 0;
+  size_t mapsize = 0;
+  std::string buffer; // the input if not mapped
+};
+
+// Output to stdout or a file, written with write(2) in large blocks rather
+// than in many small pieces. Output can also be appended to buffer directly,
+// followed by a call to flushIfFull.
+class OutputFile {
+ public:
+  ~OutputFile() {
+    flush();
+    if(reserved > written) ftruncate(fd, start + written);
+    if(fd > 1) close(fd);
+  }
+
+  // opens the named file, or stdout if the name is empty
+  bool open(const std::string& filename) {
+    fd = filename.empty() ? 1 : ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0) return false;
+    struct stat st;
+    regular = fd > 1 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+    return true;
+  }
+
+  // Opens the named file without truncating it, to overwrite its bytes from
+  // offset on, or if negative, from that many bytes before its end.
+  bool openAt(const std::string& filename, int64_t offset) {
+    fd = ::open(filename.c_str(), O_WRONLY | O_CREAT, 0644);
+    if(fd < 0) return false;
+    off_t pos = lseek(fd, offset, offset < 0 ? SEEK_END : SEEK_SET);
+    if(pos < 0) return false;
+    start = pos;
+    return true;
+  }
+
+  // Preallocates size bytes on disk when writing to a file, so that it
+  // doesn't need to grow piece by piece. If less is written, the file is
+  // truncated when done.
+  void reserve(size_t size) {
+    if(!regular) return;
+    if(posix_fallocate(fd, start, size) == 0) reserved = size;
+  }
+
+  // writes s after the buffer, without copying it if that's full anyway
+  void write(const char* s, size_t size) {
+    if(buffer.size() + size < BLOCK_SIZE) {
+      buffer.append(s, size);
+      return;
+    }
+    struct iovec iov[2];
+    iov[0].iov_base = &buffer[0];
+    iov[0].iov_len = buffer.size();
+    iov[1].iov_base = (void*)s;
+    iov[1].iov_len = size;
+    writeAll(iov, 2);
+    buffer.clear();
+  }
+
+  void write(const std::string& s) {
+    write(s.data(), s.size());
+  }
+
+  void flushIfFull() {
+    if(buffer.size() >= BLOCK_SIZE) flush();
+  }
+
+  void flush() {
+    struct iovec iov;
+    iov.iov_base = &buffer[0];
+    iov.iov_len = buffer.size();
+    writeAll(&iov, 1);
+    buffer.clear();
+  }
+
+  // amount of bytes output so far
+  size_t size() const {
+    return written + buffer.size();
+  }
+
+  std::string buffer; // output not yet written, kept to reuse its memory
+  bool failed = false; // whether a write gave an error
+  bool regular = false; // whether writing to a regular file that was opened here
+
+ private:
+  void writeAll(struct iovec* iov, int count) {
+    while(count > 0 && !failed) {
+      ssize_t n = writev(fd, iov, count);
+      if(n < 0) {
+        if(errno != EINTR) failed = true;
+        continue;
+      }
+      written += n;
+      while(count > 0 && (size_t)n >= iov->iov_len) {
+        n -= iov->iov_len;
+        iov++;
+        count--;
+      }
+      if(count > 0) {
+        iov->iov_base = (char*)iov->iov_base + n;
+        iov->iov_len -= n;
+      }
+    }
+  }
+
+  int fd = -1;
+  size_t start = 0; // offset in the file of the first written byte
+  size_t written = 0;
+  size_t reserved = 0; // size preallocated with reserve
+};
+
+static const char DECIMAL_PAIRS[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+static const char HEX_DIGITS[] = "0123456789abcdef";
+
+// Writes val in decimal or lowercase hexadecimal to out, right aligned with
+// spaces to width characters, and returns the amount of characters written.
+// out must have room for at least 20 and width characters.
+inline size_t format_uint(uint64_t val, bool hex, size_t width, char* out) {
+  char digits[20];
+  char* p = digits + 20;
+  if(hex) {
+    do {
+      *--p = HEX_DIGITS[val & 15];
+      val >>= 4;
+    } while(val);
+  } else {
+    // two digits at a time
+    while(val >= 100) {
+      size_t pair = (val % 100) * 2;
+      val /= 100;
+      p -= 2;
+      p[0] = DECIMAL_PAIRS[pair];
+      p[1] = DECIMAL_PAIRS[pair + 1];
+    }
+    if(val >= 10) {
+      p -= 2;
+      p[0] = DECIMAL_PAIRS[val * 2];
+      p[1] = DECIMAL_PAIRS[val * 2 + 1];
+    } else {
+      *--p = '0' + val;
+    }
+  }
+  size_t len = digits + 20 - p;
+  size_t pad = width > len ? width - len : 0;
+  memset(out, ' ', pad);
+  memcpy(out + pad, p, len);
+  return pad + len;
+}
+
+// appends val to out like format_uint, without a temporary string
+inline void append_uint(uint64_t val, bool hex, size_t width, std::string* out) {
+  size_t pos = out->size();
+  out->resize(pos + std::max<size_t>(width, 20));
+  out->resize(pos + format_uint(val, hex, width, &(*out)[pos]));
+}
+
+inline std::string valtostr(uint64_t val, bool hex = false) {
+  char buffer[20];
+  return std::string(buffer, format_uint(val, hex, 0, buffer));
+}
+
+template<typename T>
+T strtoval(const std::string& s) {
+  std::istringstream sstream(s);
+  T val;
+  sstream >> val;
+  return val;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static const int REPL_CHAR = 0xFFFD; // replacement character
+
+// Decodes the UTF-8 sequence at the start of a, which has the given size, to
+// *code_point and returns the amount of bytes used. Invalid sequences give
+// REPL_CHAR. If more is true and the sequence may continue past size, returns
+// 0 instead, to try again once more input is known.
+inline size_t utf8_decode_one(const uint8_t* a, size_t size, bool more, int* code_point) {
+  int b0 = a[0];
+  if(b0 < 128) {
+    *code_point = b0;
+    return 1;
+  }
+  if(b0 < 194 || b0 >= 245) {
+    *code_point = REPL_CHAR;
+    return 1;
+  }
+  if(more && size < (b0 < 224 ? 2u : b0 < 240 ? 3u : 4u)) return 0;
+  int b1 = size > 1 ? a[1] : 255;
+  int b2 = size > 2 ? a[2] : 255;
+  int b3 = size > 3 ? a[3] : 255;
+  *code_point = REPL_CHAR;
+  if(b0 < 224) {
+    if((b1 & 192) != 128) return 1;
+    *code_point = ((b0 & 31) << 6) + (b1 & 63);
+    return 2;
+  } else if(b0 < 240) {
+    if((b1 & 192) != 128) return 1;
+    if(b0 == 224 && b1 < 160) return 1;
+    if((b2 & 192) != 128) return 2;
+    *code_point = ((b0 & 15) << 12) + ((b1 & 63) << 6) + (b2 & 63);
+    return 3;
+  } else {
+    if((b1 & 192) != 128) return 1;
+    if(b0 == 240 && b1 < 144) return 1;
+    if(b0 == 244 && b1 >= 144) return 1;
+    if((b2 & 192) != 128) return 2;
+    if((b3 & 192) != 128) return 3;
+    *code_point = ((b0 & 7) << 18) + ((b1 & 63) << 12) + ((b2 & 63) << 6) + (b3 & 63);
+    return 4;
+  }
+}
+
+#if defined(BASE256_X86)
+// Converts the ASCII at the start of a to code points in out, 16 bytes at
+// once and the part of a block before its first other byte one by one.
+// Returns the amount of bytes done.
+TARGET_SSE42 inline size_t ascii_to_unicode_sse(const uint8_t* a, size_t size, int* out) {
+  const __m128i zero = _mm_setzero_si128();
+  size_t i = 0;
+  for(; i + 16 <= size; i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(a + i));
+    int mask = _mm_movemask_epi8(v);
+    if(mask) {
+      // the ASCII before the first non-ASCII byte
+      int n = __builtin_ctz(mask);
+      for(int j = 0; j < n; j++) out[i + j] = a[i + j];
+      return i + n;
+    }
+    __m128i lo = _mm_unpacklo_epi8(v, zero);
+    __m128i hi = _mm_unpackhi_epi8(v, zero);
+    _mm_storeu_si128((__m128i*)(out + i) + 0, _mm_unpacklo_epi16(lo, zero));
+    _mm_storeu_si128((__m128i*)(out + i) + 1, _mm_unpackhi_epi16(lo, zero));
+    _mm_storeu_si128((__m128i*)(out + i) + 2, _mm_unpacklo_epi16(hi, zero));
+    _mm_storeu_si128((__m128i*)(out + i) + 3, _mm_unpackhi_epi16(hi, zero));
+  }
+  return i;
+}
+
+// like ascii_to_unicode_sse with 32 bytes at once, but stops before the
+// block that has another byte
+TARGET_AVX2 inline size_t ascii_to_unicode_avx2(const uint8_t* a, size_t size, int* out) {
+  size_t i = 0;
+  for(; i + 32 <= size; i += 32) {
+    if(_mm256_movemask_epi8(_mm256_loadu_si256((const __m256i*)(a + i)))) break;
+    for(size_t k = 0; k < 4; k++) {
+      __m128i v = _mm_loadl_epi64((const __m128i*)(a + i + 8 * k));
+      _mm256_storeu_si256((__m256i*)(out + i + 8 * k), _mm256_cvtepu8_epi32(v));
+    }
+  }
+  return i;
+}
+
+// Converts the ASCII code points at the start of a to bytes in out, 16 at
+// once. Returns the amount done, which stops before the block that has
+// another code point.
+TARGET_SSE42 inline size_t unicode_to_ascii_sse(const int* a, size_t size, uint8_t* out) {
+  const __m128i high = _mm_set1_epi32(~127);
+  size_t i = 0;
+  for(; i + 16 <= size; i += 16) {
+    __m128i v0 = _mm_loadu_si128((const __m128i*)(a + i) + 0);
+    __m128i v1 = _mm_loadu_si128((const __m128i*)(a + i) + 1);
+    __m128i v2 = _mm_loadu_si128((const __m128i*)(a + i) + 2);
+    __m128i v3 = _mm_loadu_si128((const __m128i*)(a + i) + 3);
+    __m128i any = _mm_or_si128(_mm_or_si128(v0, v1), _mm_or_si128(v2, v3));
+    if(_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(any, high), _mm_setzero_si128())) != 0xffff) break;
+    __m128i lo = _mm_packs_epi32(v0, v1);
+    __m128i hi = _mm_packs_epi32(v2, v3);
+    _mm_storeu_si128((__m128i*)(out + i), _mm_packus_epi16(lo, hi));
+  }
+  return i;
+}
+
+// like unicode_to_ascii_sse with 32 code points at once
+TARGET_AVX2 inline size_t unicode_to_ascii_avx2(const int* a, size_t size, uint8_t* out) {
+  const __m256i high = _mm256_set1_epi32(~127);
+  // the packs work per 128-bit lane, this puts the dwords back in order
+  const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+  size_t i = 0;
+  for(; i + 32 <= size; i += 32) {
+    __m256i v0 = _mm256_loadu_si256((const __m256i*)(a + i) + 0);
+    __m256i v1 = _mm256_loadu_si256((const __m256i*)(a + i) + 1);
+    __m256i v2 = _mm256_loadu_si256((const __m256i*)(a + i) + 2);
+    __m256i v3 = _mm256_loadu_si256((const __m256i*)(a + i) + 3);
+    __m256i any = _mm256_or_si256(_mm256_or_si256(v0, v1), _mm256_or_si256(v2, v3));
+    if(!_mm256_testz_si256(any, high)) break;
+    __m256i lo = _mm256_packs_epi32(v0, v1);
+    __m256i hi = _mm256_packs_epi32(v2, v3);
+    __m256i bytes = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(lo, hi), order);
+    _mm256_storeu_si256((__m256i*)(out + i), bytes);
+  }
+  return i;
+}
+#endif
+
+// Converts ASCII at the start of a to code points with the SIMD kernel,
+// returns the amount done, which may be less than all of the ASCII.
+inline size_t ascii_to_unicode(const uint8_t* a, size_t size, int* out) {
+  size_t i = 0;
+#if defined(BASE256_X86)
+  switch(simd_kernel()) {
+    case KERNEL_AVX512:
+    case KERNEL_AVX2:
+      i = ascii_to_unicode_avx2(a, size, out);
+      // fall through
+    case KERNEL_SSE42:
+      i += ascii_to_unicode_sse(a + i, size - i, out + i);
+      // fall through
+    default:
+      break;
+  }
+#endif
+  return i;
+}
+
+// inverse of ascii_to_unicode
+inline size_t unicode_to_ascii(const int* a, size_t size, uint8_t* out) {
+  size_t i = 0;
+#if defined(BASE256_X86)
+  switch(simd_kernel()) {
+    case KERNEL_AVX512:
+    case KERNEL_AVX2:
+      i = unicode_to_ascii_avx2(a, size, out);
+      // fall through
+    case KERNEL_SSE42:
+      i += unicode_to_ascii_sse(a + i, size - i, out + i);
+      // fall through
+    default:
+      break;
+  }
+#endif
+  return i;
+}
+
+// Decodes size bytes of UTF-8 to out, which must have room for size code
+// points, and returns the amount of code points. Invalid sequences give
+// REPL_CHAR as in utf8_decode_one. Runs of ASCII are done with SIMD.
+inline size_t utf8_to_unicode(const uint8_t* a, size_t size, int* out) {
+  int* begin = out;
+  size_t i = 0;
+  while(i < size) {
+    size_t n = ascii_to_unicode(a + i, size - i, out);
+    i += n;
+    out += n;
+    if(i == size) break;
+    i += utf8_decode_one(a + i, size - i, false, out++);
+  }
+  return out - begin;
+}
+
+// Encodes size code points to UTF-8 in out, which must have room for 4 bytes
+// per code point, and returns the amount of bytes. Code points out of range
+// give REPL_CHAR. Runs of ASCII are done with SIMD.
+inline size_t unicode_to_utf8(const int* a, size_t size, uint8_t* out) {
+  uint8_t* begin = out;
+  size_t i = 0;
+  while(i < size) {
+    size_t n = unicode_to_ascii(a + i, size - i, out);
+    i += n;
+    out += n;
+    // up to 16 code points one by one, before trying a run of ASCII again
+    for(size_t end = std::min(size, i + 16); i < end; i++) {
+      int code_point = a[i];
+      if(code_point < 128) {
+        *out++ = code_point;
+      } else if(code_point <= 2047) {
+        *out++ = (code_point >> 6) + 192;
+        *out++ = (code_point & 63) + 128;
+      } else if(code_point <= 65535) {
+        *out++ = (code_point >> 12) + 224;
+        *out++ = ((code_point >> 6) & 63) + 128;
+        *out++ = (code_point & 63) + 128;
+      } else if(code_point <= 1114111) {
+        *out++ = (code_point >> 18) + 240;
+        *out++ = ((code_point >> 12) & 63) + 128;
+        *out++ = ((code_point >> 6) & 63) + 128;
+        *out++ = (code_point & 63) + 128;
+      } else {
+        // error, add replacement character
+        *out++ = 239;
+        *out++ = 191;
+        *out++ = 189;
+      }
+    }
+  }
+  return out - begin;
+}
+
+inline std::vector<int> utf8_to_unicode(const std::vector<uint8_t>& a) {
+  std::vector<int> result(a.size());
+  result.resize(utf8_to_unicode(a.data(), a.size(), result.data()));
+  return result;
+}
+
+inline std::vector<uint8_t> unicode_to_utf8(const std::vector<int>& a) {
+  std::vector<uint8_t> result(a.size() * 4);
+  result.resize(unicode_to_utf8(a.data(), a.size(), result.data()));
+  return result;
+}
+
+inline std::vector<uint8_t> string_to_utf8(const std::string& s) {
+  return std::vector<uint8_t>(s.begin(), s.end());
+}
+
+inline std::string utf8_to_string(const std::vector<uint8_t>& a) {
+  return std::string(a.begin(), a.end());
+}
+
+inline std::vector<int> string_to_unicode(const std::string& s) {
+  std::vector<int> result(s.size());
+  result.resize(utf8_to_unicode((const uint8_t*)s.data(), s.size(), result.data()));
+  return result;
+}
+
+inline std::string unicode_to_string(const std::vector<int>& a) {
+  std::string result(a.size() * 4, 0);
+  result.resize(unicode_to_utf8(a.data(), a.size(), (uint8_t*)&result[0]));
+  return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static const int U_NULL = 0x2400; // unicode Control Picture NUL.
+static const int U_DEL = 0x2421; // unicode Control Picture DEL.
+static const int U_SP = 0x2420; // unicode Control Picture SP
+
+static const int ALT_NULL = 0x2205; // empty set symbol indicating null
+static const int ALT_SP = 0x2423; // open box indicating space
+static const int ALT_SHY = 0x2E1A; // hyphen with dots indicating soft hyphen SHY (it does quite look like a hyphen with a shy face)
+static const int ALT_NBSP = 0x25AF; // a non-filled square indicating NBSP
+static const int ALT_DEL = 0x2302; // "house" symbol for DEL
+
+static const int table437[256] = {
+  ALT_NULL, 0x263A, 0x263B, 0x2665, 0x2666, 0x2663, 0x2660, 0x2022,
+  0x25D8, 0x25CB, 0x25D9, 0x2642, 0x2640, 0x266A, 0x266B, 0x263C,
+  0x25BA, 0x25C4, 0x2195, 0x203C, 0x00B6, 0x00A7, 0x25AC, 0x21A8,
+  0x2191, 0x2193, 0x2192, 0x2190, 0x221F, 0x2194, 0x25B2, 0x25BC,
+  ALT_SP, 0x0021, 0x0022, 0x0023, 0x0024, 0x0025, 0x0026, 0x0027,
+  0x0028, 0x0029, 0x002A, 0x002B, 0x002C, 0x002D, 0x002E, 0x002F,
+  0x0030, 0x0031, 0x0032, 0x0033, 0x0034, 0x0035, 0x0036, 0x0037,
+  0x0038, 0x0039, 0x003A, 0x003B, 0x003C, 0x003D, 0x003E, 0x003F,
+  0x0040, 0x0041, 0x0042, 0x0043, 0x0044, 0x0045, 0x0046, 0x0047,
+  0x0048, 0x0049, 0x004A, 0x004B, 0x004C, 0x004D, 0x004E, 0x004F,
+  0x0050, 0x0051, 0x0052, 0x0053, 0x0054, 0x0055, 0x0056, 0x0057,
+  0x0058, 0x0059, 0x005A, 0x005B, 0x005C, 0x005D, 0x005E, 0x005F,
+  0x0060, 0x0061, 0x0062, 0x0063, 0x0064, 0x0065, 0x0066, 0x0067,
+  0x0068, 0x0069, 0x006A, 0x006B, 0x006C, 0x006D, 0x006E, 0x006F,
+  0x0070, 0x0071, 0x0072, 0x0073, 0x0074, 0x0075, 0x0076, 0x0077,
+  0x0078, 0x0079, 0x007A, 0x007B, 0x007C, 0x007D, 0x007E, 0x2302,
+  0x00C7, 0x00FC, 0x00E9, 0x00E2, 0x00E4, 0x00E0, 0x00E5, 0x00E7,
+  0x00EA, 0x00EB, 0x00E8, 0x00EF, 0x00EE, 0x00EC, 0x00C4, 0x00C5,
+  0x00C9, 0x00E6, 0x00C6, 0x00F4, 0x00F6, 0x00F2, 0x00FB, 0x00F9,
+  0x00FF, 0x00D6, 0x00DC, 0x00A2, 0x00A3, 0x00A5, 0x20A7, 0x0192,
+  0x00E1, 0x00ED, 0x00F3, 0x00FA, 0x00F1, 0x00D1, 0x00AA, 0x00BA,
+  0x00BF, 0x2310, 0x00AC, 0x00BD, 0x00BC, 0x00A1, 0x00AB, 0x00BB,
+  0x2591, 0x2592, 0x2593, 0x2502, 0x2524, 0x2561, 0x2562, 0x2556,
+  0x2555, 0x2563, 0x2551, 0x2557, 0x255D, 0x255C, 0x255B, 0x2510,
+  0x2514, 0x2534, 0x252C, 0x251C, 0x2500, 0x253C, 0x255E, 0x255F,
+  0x255A, 0x2554, 0x2569, 0x2566, 0x2560, 0x2550, 0x256C, 0x2567,
+  0x2568, 0x2564, 0x2565, 0x2559, 0x2558, 0x2552, 0x2553, 0x256B,
+  0x256A, 0x2518, 0x250C, 0x2588, 0x2584, 0x258C, 0x2590, 0x2580,
+  0x03B1, 0x00DF, 0x0393, 0x03C0, 0x03A3, 0x03C3, 0x00B5, 0x03C4,
+  0x03A6, 0x0398, 0x03A9, 0x03B4, 0x221E, 0x03C6, 0x03B5, 0x2229,
+  0x2261, 0x00B1, 0x2265, 0x2264, 0x2320, 0x2321, 0x00F7, 0x2248,
+  0x00B0, 0x2219, 0x00B7, 0x221A, 0x207F, 0x00B2, 0x25A0, ALT_NBSP
+};
+
+static const int ALT_81 = 0x201B; // normally 'C1 control code HOP'
+static const int ALT_8D = 0x010C; // normally 'C1 control code RI'
+static const int ALT_8F = 0x017F; // normally 'C1 control code SS3'
+static const int ALT_90 = 0x0111; // normally 'C1 control code DCS'
+static const int ALT_9D = 0x010D; // normally 'C1 control code OSC'
+
+// Code page 1252, but missing spots filled up with other characters to have
+// the full 256 unique glyphs: greek characters in rows 0/1 and characters that
+// blend in for rows 8 and 9.
+static const int table1252[256] = {
+  ALT_NULL, 0x03B1, 0x03B2, 0x03B3, 0x03B4, 0x03B5, 0x03B6, 0x03B7,
+  0x03B8, 0x03B9, 0x03BA, 0x03BB, 0x03BC, 0x03BD, 0x03BE, 0x03B0,
+  0x03C0, 0x03C1, 0x03C2, 0x03C3, 0x03C4, 0x03C5, 0x03C6, 0x03C7,
+  0x03C8, 0x03C9, 0x03CA, 0x03CB, 0x03AC, 0x03CD, 0x03CE, 0x03AF,
+  ALT_SP, 0x0021, 0x0022, 0x0023, 0x0024, 0x0025, 0x0026, 0x0027,
+  0x0028, 0x0029, 0x002A, 0x002B, 0x002C, 0x002D, 0x002E, 0x002F,
+  0x0030, 0x0031, 0x0032, 0x0033, 0x0034, 0x0035, 0x0036, 0x0037,
+  0x0038, 0x0039, 0x003A, 0x003B, 0x003C, 0x003D, 0x003E, 0x003F,
+  0x0040, 0x0041, 0x0042, 0x0043, 0x0044, 0x0045, 0x0046, 0x0047,
+  0x0048, 0x0049, 0x004A, 0x004B, 0x004C, 0x004D, 0x004E, 0x004F,
+  0x0050, 0x0051, 0x0052, 0x0053, 0x0054, 0x0055, 0x0056, 0x0057,
+  0x0058, 0x0059, 0x005A, 0x005B, 0x005C, 0x005D, 0x005E, 0x005F,
+  0x0060, 0x0061, 0x0062, 0x0063, 0x0064, 0x0065, 0x0066, 0x0067,
+  0x0068, 0x0069, 0x006A, 0x006B, 0x006C, 0x006D, 0x006E, 0x006F,
+  0x0070, 0x0071, 0x0072, 0x0073, 0x0074, 0x0075, 0x0076, 0x0077,
+  0x0078, 0x0079, 0x007A, 0x007B, 0x007C, 0x007D, 0x007E,  ALT_DEL,
+  0x20AC, ALT_81, 0x201A, 0x0192, 0x201E, 0x2026, 0x2020, 0x2021,
+  0x02C6, 0x2030, 0x0160, 0x2039, 0x0152, ALT_8D, 0x017D, ALT_8F,
+  ALT_90, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014,
+  0x02DC, 0x2122, 0x0161, 0x203A, 0x0153, ALT_9D, 0x017E, 0x0178,
+  ALT_NBSP, 0x00A1, 0x00A2, 0x00A3, 0x00A4, 0x00A5, 0x00A6, 0x00A7,
+  0x00A8, 0x00A9, 0x00AA, 0x00AB, 0x00AC, ALT_SHY, 0x00AE, 0x00AF,
+  0x00B0, 0x00B1, 0x00B2, 0x00B3, 0x00B4, 0x00B5, 0x00B6, 0x00B7,
+  0x00B8, 0x00B9, 0x00BA, 0x00BB, 0x00BC, 0x00BD, 0x00BE, 0x00BF,
+  0x00C0, 0x00C1, 0x00C2, 0x00C3, 0x00C4, 0x00C5, 0x00C6, 0x00C7,
+  0x00C8, 0x00C9, 0x00CA, 0x00CB, 0x00CC, 0x00CD, 0x00CE, 0x00CF,
+  0x00D0, 0x00D1, 0x00D2, 0x00D3, 0x00D4, 0x00D5, 0x00D6, 0x00D7,
+  0x00D8, 0x00D9, 0x00DA, 0x00DB, 0x00DC, 0x00DD, 0x00DE, 0x00DF,
+  0x00E0, 0x00E1, 0x00E2, 0x00E3, 0x00E4, 0x00E5, 0x00E6, 0x00E7,
+  0x00E8, 0x00E9, 0x00EA, 0x00EB, 0x00EC, 0x00ED, 0x00EE, 0x00EF,
+  0x00F0, 0x00F1, 0x00F2, 0x00F3, 0x00F4, 0x00F5, 0x00F6, 0x00F7,
+  0x00F8, 0x00F9, 0x00FA, 0x00FB, 0x00FC, 0x00FD, 0x00FE, 0x00FF
+};
+
+// Describes formats that print every byte as the same fixed pattern of
+// constant characters and two values computed from the byte, which allows
+// encoding many bytes at once with a PatternEncoder.
+struct BytePattern {
+  enum Kind {
+    NONE,
+    NIBBLES, // the values are the digits of the high and the low nibble
+    BRAILLE // the values are the last two UTF-8 bytes of U+2800 + byte
+  };
+  Kind kind = NONE;
+  std::string pattern; // '\1' and '\2' stand for the first and second value
+  const char* digits = 0; // for NIBBLES: the 16 digits
+  bool altnull = false; // for BRAILLE: show byte 0 as ALT_NULL rather than U+2800
+};
+
+// State of one encode or decode stream. Formats keep what they need to
+// remember between bytes here rather than in themselves, so that the input
+// can be given in parts of any size.
+struct FormatState {
+  size_t num = 0; // amount of bytes encoded, or position in the text decoded so far
+  size_t v = 0; // bits or value of the unfinished byte or group
+  int count = 0; // amount of digits or characters in v
+  size_t start = 0; // position of the first character of v, for messages
+  int mode = 0; // format specific, e.g. whether a prefix may be starting
+  std::string pending; // input of an unfinished UTF-8 sequence
+  bool reported = false; // whether a message that is only given once was given
+  int separator = 0; // length of the ", " of comma after every byte, when decoding glyphs or strings
+  int skip = 0; // characters of the separator still to skip
+  std::string messages; // diagnostics of decoding, a line each, until the caller takes them
+};
+
+// adds a line to the diagnostics of decoding in the state
+inline void report(FormatState* state, const std::string& message) {
+  state->messages += message;
+  state->messages += '\n';
+}
+
+// first position from pos on that comes right after whitespace, or size
+inline size_t split_after_space(const char* s, size_t size, size_t pos) {
+  while(pos < size && (unsigned char)s[pos] > 32) pos++;
+  return pos < size ? pos + 1 : size;
+}
+
+// first position from pos on that comes right after a newline, or size
+inline size_t split_after_newline(const char* s, size_t size, size_t pos) {
+  const char* nl = pos < size ? (const char*)memchr(s + pos, '\n', size - pos) : 0;
+  return nl ? nl - s + 1 : size;
+}
+
+// first position from pos on that comes right after the ", " separator of
+// comma or a newline, or size
+inline size_t split_after_separator(const char* s, size_t size, size_t pos) {
+  for(; pos < size; pos++) {
+    if(s[pos] == '\n') return pos + 1;
+    if(s[pos] == ',' && pos + 1 < size && s[pos + 1] == ' ') return pos + 2;
+  }
+  return size;
+}
+
+// first position from pos on where an UTF-8 sequence starts, or size
+inline size_t split_utf8(const char* s, size_t size, size_t pos) {
+  while(pos < size && (s[pos] & 0xc0) == 0x80) pos++;
+  return pos;
+}
+
+// outputs a decoded byte of a string literal, after which the separator of
+// comma follows
+inline void decode_string_byte(char c, FormatState* state, std::string* out) {
+  out->push_back(c);
+  state->skip = state->separator;
+}
+
+// outputs the value of a numeric escape, as UTF-8 if it's not a byte
+inline void decode_escape_value(FormatState* state, std::string* out) {
+  if(state->count == 0) return;
+  if(state->v < 256) decode_string_byte((char)state->v, state, out);
+  else *out += unicode_to_string({(int)state->v});
+}
+
+// Decodes the string literals in the text that are quoted with quote, with
+// the escapes that the string formats use. What is outside the quotes, such
+// as "std::string(", " +" or the size comment, is skipped, as is a backslash
+// before a newline. In the state, mode is 0 outside a literal, 1 inside, 2
+// after a backslash, and 3, 4 or 5 in an octal, \x or \u escape with count
+// digits of value v so far.
+inline void decode_string_literal(const char* s, size_t size, char quote, FormatState* state, std::string* out) {
+  for(size_t i = 0; i < size; i++) {
+    char c = s[i];
+    if(state->mode >= 3) {
+      int d = -1;
+      if(c >= '0' && c <= '9') d = c - '0';
+      else if(state->mode != 3 && c >= 'a' && c <= 'f') d = c - 'a' + 10;
+      else if(state->mode != 3 && c >= 'A' && c <= 'F') d = c - 'A' + 10;
+      if(state->mode == 3 && d >= 8) d = -1;
+      if(d >= 0) {
+        state->v = state->v * (state->mode == 3 ? 8 : 16) + d;
+        state->count++;
+        int maxcount = state->mode == 3 ? 3 : state->mode == 4 ? 2 : 4;
+        if(state->count < maxcount) continue;
+      }
+      decode_escape_value(state, out);
+      state->mode = 1;
+      if(d >= 0) continue;
+    }
+    if(state->skip > 0) {
+      state->skip--;
+      continue;
+    }
+    if(state->mode == 0) {
+      if(c == quote) state->mode = 1;
+    } else if(state->mode == 1) {
+      if(c == '\\') state->mode = 2;
+      else if(c == quote) state->mode = 0;
+      else if(c != '\n') decode_string_byte(c, state, out);
+    } else {
+      state->mode = 1;
+      state->v = 0;
+      state->count = 0;
+      switch(c) {
+        case 'a': decode_string_byte('\a', state, out); break;
+        case 'b': decode_string_byte('\b', state, out); break;
+        case 'f': decode_string_byte('\f', state, out); break;
+        case 'n': decode_string_byte('\n', state, out); break;
+        case 'r': decode_string_byte('\r', state, out); break;
+        case 't': decode_string_byte('\t', state, out); break;
+        case 'v': decode_string_byte('\v', state, out); break;
+        case 'x': state->mode = 4; break;
+        case 'u': state->mode = 5; break;
+        case '\n': break; // continues on the next line
+        default:
+          if(c >= '0' && c <= '7') {
+            state->mode = 3;
+            state->v = c - '0';
+            state->count = 1;
+          } else {
+            decode_string_byte(c, state, out); // \\, quotes and \?
+          }
+      }
+    }
+  }
+}
+
+// ends decode_string_literal, with an escape that may have been unfinished
+inline void decode_string_literal_finish(FormatState* state, std::string* out) {
+  if(state->mode >= 3) decode_escape_value(state, out);
+  state->mode = 0;
+}
+
+class Format {
+ public:
+  virtual ~Format() {}
+  // prev and next char not used by all formats, and set to 0 if nonexistant
+  virtual std::string encodeChar(unsigned char c, unsigned char prev, unsigned char next, FormatState* state) = 0;
+
+  // Decodes the next size characters of the input, appending to out. The
+  // state starts as a default FormatState, and decodeFinish must be called
+  // after the last part.
+  virtual void decodeFeed(const char* s, size_t size, FormatState* state, std::string* out) {
+    if(!state->reported) report(state, "Decode not implemented for this format!");
+    state->reported = true;
+  }
+
+  // ends decoding, appending what remains to out
+  virtual void decodeFinish(FormatState* state, std::string* out) {
+  }
+
+  // decodes a whole input at once
+  std::string decode(const std::string& s) {
+    std::string result;
+    FormatState state;
+    decodeFeed(s.data(), s.size(), &state, &result);
+    decodeFinish(&state, &result);
+    return result;
+  }
+
+  // Returns the first position from pos on where the text to decode can be
+  // split in parts that decode independently, as long as the state after the
+  // first part is clean (see decodeClean). Returns size if there is none, which
+  // is the default, for formats that can't decode.
+  virtual size_t decodeSplit(const char* s, size_t size, size_t pos) const {
+    return size;
+  }
+
+  // whether the decode state is the same as a new state, for decodeSplit
+  virtual bool decodeClean(const FormatState& state) const {
+    return state.count == 0 && state.mode == 0 && state.pending.empty() && state.skip == 0;
+  }
+
+  // whether encodeChar depends on nothing but the byte itself (not on prev,
+  // next or earlier bytes), so that its result can be precomputed for all 256
+  // values
+  virtual bool contextfree() const {
+    return false;
+  }
+
+  // whether encodeBlock is implemented
+  virtual bool blockencode() const {
+    return false;
+  }
+
+  // amount of input bytes encoded together, with state carried between them
+  // in FormatState. The input can only be split in independent parts at a
+  // multiple of this.
+  virtual size_t groupsize() const {
+    return 1;
+  }
+
+  // encodes size bytes at once, appending to out the same as encodeChar would
+  // give for each of them in order. Only for formats not needing prev and next.
+  virtual void encodeBlock(const unsigned char* in, size_t size, FormatState* state, std::string* out) {
+  }
+
+  // for formats that print every byte as the same fixed pattern, see
+  // BytePattern
+  virtual BytePattern bytepattern() const {
+    return BytePattern();
+  }
+
+  // for formats that are colored themselves, the ANSI escape code that sets
+  // the background color of byte c. The Printer only outputs it where the
+  // color changes, and resets it at the end of lines.
+  virtual std::string colorcode(unsigned char c) const {
+    return "";
+  }
+
+  // size (in glyphs) of each printed byte
+  virtual int width() const {
+    return 1;
+  }
+
+  // whether there should be a space between the values (this adds one more
+  // to width in addition to width())
+  virtual bool space() const {
+    return false;
+  }
+
+  // whether this format prints most printable ascii characters as-is (small
+  // exceptions, such as escape codes for string literals, may happen).
+  // if this is true, then no separate "mix" mode that mixes in printable
+  // ascii characters in the notation will be supported for this format (since
+  // it already prints printable ascii characters on its own)
+  virtual bool printable() const {
+    return false;
+  }
+
+  // could be e.g. q quote character for C string literal
+  virtual std::string open() {
+    return "";
+  }
+
+  // could be e.g. q quote character for C string literal
+  virtual std::string close(const FormatState& state) {
+    return "";
+  }
+
+  // optional extra to begin in-between lines with, e.g. " for C string literal
+  virtual std::string linebeg() {
+    return "";
+  }
+
+  // optional extra to end in-between lines with, e.g. " for C string literal
+  virtual std::string lineend() {
+    return "";
+  }
+
+  // whether the string representation allows line wrapping at all
+  virtual bool allowlinebreaks() {
+    return true;
+  }
+
+  // align based on input byte size or output character size
+  virtual bool outwidth() {
+    return false;
+  }
+};
+
+// Encoder for formats that print every byte as the same fixed pattern, e.g.
+// "0x\1\2, " for hex with prefix and comma, where '\1' is the high and '\2'
+// the low digit. Computes the values for blocks of 16 (SSE4.2), 32 (AVX2) or
+// 64 (AVX-512) bytes at once, with the kernel of simd_kernel, then shuffles
+// those into the pattern. Bytes that don't fill a whole block are left to the
+// caller.
+class PatternEncoder {
+ public:
+  // returns false if the pattern is not supported
+  bool init(const BytePattern& p) {
+    if(p.kind == BytePattern::NONE || p.pattern.empty() || p.pattern.size() > 8) return false;
+    if(p.kind == BytePattern::NIBBLES && !p.digits) return false;
+    kind = p.kind;
+    stride = p.pattern.size();
+    if(p.digits) memcpy(digits, p.digits, 16);
+    // ALT_NULL has the same first UTF-8 byte as the braille patterns
+    altnull = p.altnull;
+    nullvalues[0] = 0x80 | ((ALT_NULL >> 6) & 63);
+    nullvalues[1] = 0x80 | (ALT_NULL & 63);
+    for(size_t j = 0; j < 16 * stride; j++) {
+      size_t b = j / stride; // index of the input byte in the block
+      char c = p.pattern[j % stride];
+      idxa[j] = idxb[j] = 0x80; // pshufb index with high bit set gives zero
+      tmpl[j] = 0;
+      if(c == 1 || c == 2) {
+        unsigned char index = 2 * (b & 7) + (c == 2 ? 1 : 0);
+        if(b < 8) idxa[j] = index;
+        else idxb[j] = index;
+      } else {
+        tmpl[j] = c;
+      }
+    }
+    return true;
+  }
+
+  // Encodes as many whole blocks as fit in size to out, which must have room
+  // for stride bytes per input byte. Returns the amount of input bytes done,
+  // which is 0 with the scalar kernel.
+  size_t encode(const unsigned char* in, size_t size, char* out) const {
+    size_t i = 0;
+#if defined(BASE256_X86)
+    switch(simd_kernel()) {
+      case KERNEL_AVX512:
+        i = encodeAVX512(in, size, out);
+        // fall through
+      case KERNEL_AVX2:
+        i += encodeAVX2(in + i, size - i, out + i * stride);
+        // fall through
+      case KERNEL_SSE42:
+        i += encodeSSE(in + i, size - i, out + i * stride);
+        // fall through
+      default:
+        break;
+    }
+#endif
+    return i;
+  }
+
+  BytePattern::Kind kind = BytePattern::NONE;
+  size_t stride = 0; // output bytes per input byte
+  char digits[16];
+  bool altnull = false;
+  unsigned char nullvalues[2];
+  // per output byte of a block: index in the value pairs of bytes 0-7 (idxa)
+  // or bytes 8-15 (idxb) or 0x80 if none, and the constant character or 0
+  unsigned char idxa[128];
+  unsigned char idxb[128];
+  unsigned char tmpl[128];
+
+ private:
+#if defined(BASE256_X86)
+  // each 128-bit lane does one block of 16 bytes
+  TARGET_AVX512 size_t encodeAVX512(const unsigned char* in, size_t size, char* out) const {
+    size_t i = 0;
+    for(; i + 64 <= size; i += 64) {
+      __m512i first, second;
+      values(_mm512_loadu_si512((const void*)(in + i)), &first, &second);
+      __m512i a = _mm512_unpacklo_epi8(first, second); // value pairs of bytes 0-7 of each lane
+      __m512i b = _mm512_unpackhi_epi8(first, second); // value pairs of bytes 8-15 of each lane
+      char* o = out + i * stride;
+      for(size_t k = 0; k < stride; k++) {
+        __m512i ia = broadcast_lanes(_mm_loadu_si128((const __m128i*)(idxa + 16 * k)));
+        __m512i ib = broadcast_lanes(_mm_loadu_si128((const __m128i*)(idxb + 16 * k)));
+        __m512i t = broadcast_lanes(_mm_loadu_si128((const __m128i*)(tmpl + 16 * k)));
+        __m512i r = _mm512_or_si512(_mm512_or_si512(_mm512_shuffle_epi8(a, ia), _mm512_shuffle_epi8(b, ib)), t);
+        _mm_storeu_si128((__m128i*)(o + 16 * k), extract_lane<0>(r));
+        _mm_storeu_si128((__m128i*)(o + 16 * (stride + k)), extract_lane<1>(r));
+        _mm_storeu_si128((__m128i*)(o + 16 * (2 * stride + k)), extract_lane<2>(r));
+        _mm_storeu_si128((__m128i*)(o + 16 * (3 * stride + k)), extract_lane<3>(r));
+      }
+    }
+    return i;
+  }
+
+  TARGET_AVX2 size_t encodeAVX2(const unsigned char* in, size_t size, char* out) const {
+    size_t i = 0;
+    for(; i + 32 <= size; i += 32) {
+      __m256i first, second;
+      values(_mm256_loadu_si256((const __m256i*)(in + i)), &first, &second);
+      __m256i a = _mm256_unpacklo_epi8(first, second);
+      __m256i b = _mm256_unpackhi_epi8(first, second);
+      char* o = out + i * stride;
+      for(size_t k = 0; k < stride; k++) {
+        __m256i ia = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)(idxa + 16 * k)));
+        __m256i ib = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)(idxb + 16 * k)));
+        __m256i t = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)(tmpl + 16 * k)));
+        __m256i r = _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(a, ia), _mm256_shuffle_epi8(b, ib)), t);
+        _mm_storeu_si128((__m128i*)(o + 16 * k), _mm256_castsi256_si128(r));
+        _mm_storeu_si128((__m128i*)(o + 16 * (stride + k)), _mm256_extracti128_si256(r, 1));
+      }
+    }
+    return i;
+  }
+
+  TARGET_SSE42 size_t encodeSSE(const unsigned char* in, size_t size, char* out) const {
+    size_t i = 0;
+    for(; i + 16 <= size; i += 16) {
+      __m128i first, second;
+      values(_mm_loadu_si128((const __m128i*)(in + i)), &first, &second);
+      __m128i a = _mm_unpacklo_epi8(first, second); // value pairs of bytes 0-7
+      __m128i b = _mm_unpackhi_epi8(first, second); // value pairs of bytes 8-15
+      char* o = out + i * stride;
+      for(size_t k = 0; k < stride; k++) {
+        __m128i ia = _mm_loadu_si128((const __m128i*)(idxa + 16 * k));
+        __m128i ib = _mm_loadu_si128((const __m128i*)(idxb + 16 * k));
+        __m128i t = _mm_loadu_si128((const __m128i*)(tmpl + 16 * k));
+        __m128i r = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, ia), _mm_shuffle_epi8(b, ib)), t);
+        _mm_storeu_si128((__m128i*)(o + 16 * k), r);
+      }
+    }
+    return i;
+  }
+
+  TARGET_AVX512 void values(__m512i v, __m512i* first, __m512i* second) const {
+    if(kind == BytePattern::NIBBLES) {
+      const __m512i lut = broadcast_lanes(_mm_loadu_si128((const __m128i*)digits));
+      const __m512i mask = _mm512_set1_epi8(15);
+      *first = _mm512_shuffle_epi8(lut, _mm512_and_si512(_mm512_srli_epi16(v, 4), mask));
+      *second = _mm512_shuffle_epi8(lut, _mm512_and_si512(v, mask));
+    } else {
+      *first = _mm512_or_si512(_mm512_and_si512(_mm512_srli_epi16(v, 6), _mm512_set1_epi8(3)), _mm512_set1_epi8((char)0xa0));
+      *second = _mm512_or_si512(_mm512_and_si512(v, _mm512_set1_epi8(63)), _mm512_set1_epi8((char)0x80));
+      if(altnull) {
+        __mmask64 z = _mm512_cmpeq_epi8_mask(v, _mm512_setzero_si512());
+        *first = _mm512_mask_blend_epi8(z, *first, _mm512_set1_epi8(nullvalues[0]));
+        *second = _mm512_mask_blend_epi8(z, *second, _mm512_set1_epi8(nullvalues[1]));
+      }
+    }
+  }
+
+  TARGET_AVX2 void values(__m256i v, __m256i* first, __m256i* second) const {
+    if(kind == BytePattern::NIBBLES) {
+      const __m256i lut = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)digits));
+      const __m256i mask = _mm256_set1_epi8(15);
+      *first = _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), mask));
+      *second = _mm256_shuffle_epi8(lut, _mm256_and_si256(v, mask));
+    } else {
+      *first = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi16(v, 6), _mm256_set1_epi8(3)), _mm256_set1_epi8((char)0xa0));
+      *second = _mm256_or_si256(_mm256_and_si256(v, _mm256_set1_epi8(63)), _mm256_set1_epi8((char)0x80));
+      if(altnull) {
+        __m256i z = _mm256_cmpeq_epi8(v, _mm256_setzero_si256());
+        *first = _mm256_or_si256(_mm256_andnot_si256(z, *first), _mm256_and_si256(z, _mm256_set1_epi8(nullvalues[0])));
+        *second = _mm256_or_si256(_mm256_andnot_si256(z, *second), _mm256_and_si256(z, _mm256_set1_epi8(nullvalues[1])));
+      }
+    }
+  }
+
+  TARGET_SSE42 void values(__m128i v, __m128i* first, __m128i* second) const {
+    if(kind == BytePattern::NIBBLES) {
+      const __m128i lut = _mm_loadu_si128((const __m128i*)digits);
+      const __m128i mask = _mm_set1_epi8(15);
+      *first = _mm_shuffle_epi8(lut, _mm_and_si128(_mm_srli_epi16(v, 4), mask));
+      *second = _mm_shuffle_epi8(lut, _mm_and_si128(v, mask));
+    } else {
+      *first = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(v, 6), _mm_set1_epi8(3)), _mm_set1_epi8((char)0xa0));
+      *second = _mm_or_si128(_mm_and_si128(v, _mm_set1_epi8(63)), _mm_set1_epi8((char)0x80));
+      if(altnull) {
+        __m128i z = _mm_cmpeq_epi8(v, _mm_setzero_si128());
+        *first = _mm_or_si128(_mm_andnot_si128(z, *first), _mm_and_si128(z, _mm_set1_epi8(nullvalues[0])));
+        *second = _mm_or_si128(_mm_andnot_si128(z, *second), _mm_and_si128(z, _mm_set1_epi8(nullvalues[1])));
+      }
+    }
+  }
+#endif
+};
+
+// Precomputed output of Printer::encodeChar for all 256 byte values, including
+// the comma and space that Printer::encode adds after each value. Each entry
+// is stored zero padded in a fixed size slot, so that it can be copied with a
+// fixed size memcpy after which the output only advances by its real length.
+struct ByteTable {
+  size_t stride = 0; // slot size in bytes, a power of two
+  std::string data; // 256 slots of stride bytes each
+  size_t len[256];
+  size_t outwidth[256];
+  bool newline[256]; // the entry is a bare newline, which resets the wrap counter
+  bool newlines = false; // whether any entry is a newline
+  int color[256]; // color of the entry, see Printer::colorcodes, or -1
+  bool colored = false; // whether any entry has a color
+  size_t separator = 0; // length of the ", " of comma or the space at the end of every entry, which has no background color
+};
+
+// Makes the parts 0 to numparts - 1 of an output with work(k, &part) on
+// numthreads threads, and gives them to done(k, &part) in order, with at most
+// 2 * numthreads parts waiting. Stops early if done returns false.
+inline void run_parts(size_t numparts, size_t numthreads,
+               const std::function<void(size_t, std::string*)>& work,
+               const std::function<bool(size_t, std::string*)>& done) {
+  std::vector<std::string> parts(numparts);
+  std::vector<char> finished(numparts, 0);
+  std::mutex mutex;
+  std::condition_variable cond;
+  size_t next = 0; // next part to make
+  size_t given = 0; // next part to give to done
+  size_t window = numthreads * 2;
+
+  std::vector<std::thread> threads;
+  for(size_t t = 0; t < numthreads && t < numparts; t++) {
+    threads.push_back(std::thread([&]() {
+      for(;;) {
+        size_t k;
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          cond.wait(lock, [&]() { return next >= numparts || next < given + window; });
+          if(next >= numparts) return;
+          k = next++;
+        }
+        std::string part;
+        work(k, &part);
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          parts[k].swap(part);
+          finished[k] = 1;
+        }
+        cond.notify_all();
+      }
+    }));
+  }
+  for(size_t k = 0; k < numparts; k++) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      cond.wait(lock, [&]() { return finished[k] != 0; });
+    }
+    bool ok = done(k, &parts[k]);
+    std::string().swap(parts[k]);
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      given++;
+      if(!ok) next = numparts;
+    }
+    cond.notify_all();
+    if(!ok) break;
+  }
+  for(size_t t = 0; t < threads.size(); t++) threads[t].join();
+}
+
+static const char* const COLOR_RESET = "\x1b[0m";
+
+// Where an encode stream is: what the output of the next bytes depends on
+// besides the bytes themselves. Each part has its own when encoding with
+// threads.
+struct PrintPosition {
+  FormatState state;
+  size_t offset = 0; // position in the whole input of the next byte to encode
+  int numbytes = 0; // for wrap
+  int colornow = -1; // color that the output is in, -1 for none
+  bool held = false; // whether heldbyte still needs to be encoded
+  unsigned char heldbyte = 0;
+  unsigned char prevbyte = 0; // the byte before heldbyte
+};
+
+// Where a decode stream is, like PrintPosition when encoding: the state of
+// the format and of what the Printer itself skips.
+struct DecodePosition {
+  FormatState state;
+  std::string token; // unfinished token when decoding in mix mode
+  int skipping = 0; // 1 in a line number, 2 at the space after it
+  bool inescape = false; // in a color escape code
+};
+
+// Settings of a Printer and its format, the same as the command line options
+struct Base256Config {
+  std::string format = "cp437"; // name as given to --format
+  int wrap = 0; // add newlines every so many input bytes, 0 for none
+  bool printlinenumbers = false;
+  int linenumbersbase = 10; // 10 or 16
+  bool colored = false;
+  bool comma = false;
+  bool mix = false;
+  bool printnewline = false;
+  bool printspace = false;
+  bool printnull = false;
+  bool prefix = false;
+  bool lower = true; // lower case hex digits, like the command line does by default
+  bool lsb_first = false;
+};
+
+class Printer {
+ public:
+  Printer(Format* n) : n(n) {
+    initColors();
+  }
+
+  // Takes the settings of config, for a format that was made with it (see
+  // makeFormats). Call before the first encode.
+  void configure(const Base256Config& config) {
+    printlinenumbers = config.printlinenumbers;
+    linenumbersbase = config.linenumbersbase;
+    // the format that is itself colored is incompatible with the extra coloring
+    colored = config.colored && config.format != "colored";
+    comma = config.comma;
+    mix = config.mix;
+    printnewline = config.printnewline;
+    printspace = config.printspace;
+    wrap = config.wrap;
+    lsb_first = config.lsb_first;
+  }
+
+  // Encodes a byte with its color escape codes around it.
+  // width = original width before adding formatting like ANSI colors
+  std::string encodeChar(unsigned char c, unsigned char prev, unsigned char next, size_t* width) const {
+    int color;
+    FormatState state;
+    std::string result = encodeGlyph(c, prev, next, width, &color, &state);
+    if(color >= 0) result = colorcodes[color] + result + COLOR_RESET;
+    return result;
+  }
+
+  // Encodes a byte without color, and gives its color in *color, -1 if none,
+  // else an index in colorcodes.
+  std::string encodeGlyph(unsigned char c, unsigned char prev, unsigned char next, size_t* width, int* color, FormatState* state) const {
+    std::string temp = n->encodeChar(c, prev, next, state);
+    *width = temp.size();
+    *color = -1;
+    if(printspace && c == 32 && (mix || n->printable())) {
+      std::string result;
+      for(size_t i = 0; i < n->width(); i++) {
+        result += " ";
+      }
+      return result;
+    }
+    if(temp == "\n") return temp;
+    if(c == 10 && printnewline && (mix || n->printable())) return "\n";
+    if(mix && c > 32 && c < 127 && !n->printable()) {
+      std::string result;
+      size_t size = n->width() - 1;
+      for(size_t i = 0; i < size; i++) {
+        result += " ";
+      }
+      result += c;
+      return result;
+    }
+    if(!colorcodes[16 + c].empty()) {
+      *color = 16 + c;
+    } else if(colored && !(temp.size() == 1 && (unsigned char)temp[0] == c)) {
+      *color = c >> 4;
+    }
+    return temp;
+  }
+
+  // Builds the byte table, returns false if the format or settings don't
+  // allow using one. Since the table depends on the settings, they must be
+  // configured before the first encode.
+  bool initTable() {
+    if(table.stride) return true;
+    if(!n->contextfree() || n->outwidth()) return false;
+    std::string entries[256];
+    size_t maxlen = 0;
+    table.separator = (comma ? 1 : 0) + (comma || n->space() ? 1 : 0);
+    for(int c = 0; c < 256; c++) {
+      FormatState state;
+      std::string temp = encodeGlyph(c, 0, 0, &table.outwidth[c], &table.color[c], &state);
+      table.newline[c] = (temp == "\n");
+      if(table.newline[c]) table.newlines = true;
+      if(table.color[c] >= 0) table.colored = true;
+      if(comma) temp += ",";
+      if(comma || n->space()) temp += " ";
+      table.len[c] = temp.size();
+      maxlen = std::max(maxlen, temp.size());
+      entries[c] = temp;
+    }
+    size_t stride = 4;
+    while(stride < maxlen) stride *= 2;
+    if(stride > 64) return false;
+    table.data.assign(256 * stride, 0);
+    for(int c = 0; c < 256; c++) {
+      table.data.replace(c * stride, entries[c].size(), entries[c]);
+    }
+    table.stride = stride;
+    // the pattern encoder doesn't know about the exceptions made for printable
+    // characters or colors
+    BytePattern pattern = n->bytepattern();
+    if(pattern.kind != BytePattern::NONE && !mix && !colored) {
+      if(comma) pattern.pattern += ",";
+      if(comma || n->space()) pattern.pattern += " ";
+      usepattern = patternencoder.init(pattern);
+    }
+    return true;
+  }
+
+  // Encodes up to size bytes from in with the byte table to out, which must
+  // have room for size * STRIDE bytes. Returns the amount of input bytes used,
+  // and the amount of output bytes written in *outsize. Specialized on the
+  // stride, and on NEWLINE to stop after a byte that encodes as a newline,
+  // for wrapping. Bytes that encode as themselves, like printable ASCII in
+  // the code pages, take the same fixed size copy: copying runs of them in
+  // SIMD blocks was slower, since on real input the runs are short.
+  template<size_t STRIDE, bool NEWLINE>
+  size_t encodeRun(const unsigned char* in, size_t size, char* out, size_t* outsize) const {
+    const char* data = table.data.data();
+    char* begin = out;
+    size_t i = 0;
+    while(i < size) {
+      unsigned char c = in[i++];
+      memcpy(out, data + c * STRIDE, STRIDE);
+      out += table.len[c];
+      if(NEWLINE && table.newline[c]) break;
+    }
+    *outsize = out - begin;
+    return i;
+  }
+
+  typedef size_t (Printer::*RunFunction)(const unsigned char* in, size_t size, char* out, size_t* outsize) const;
+
+  template<size_t STRIDE>
+  RunFunction runFunction(bool newline) const {
+    return newline ? &Printer::encodeRun<STRIDE, true> : &Printer::encodeRun<STRIDE, false>;
+  }
+
+  // Chooses the encodeRun for the table and settings, once per stream. Only
+  // with wrapping does the run need to stop at newlines, to reset the wrap
+  // counter.
+  RunFunction runFunction() const {
+    bool newline = table.newlines && wrap != 0;
+    switch(table.stride) {
+      case 4: return runFunction<4>(newline);
+      case 8: return runFunction<8>(newline);
+      case 16: return runFunction<16>(newline);
+      case 32: return runFunction<32>(newline);
+      default: return runFunction<64>(newline);
+    }
+  }
+
+  // Like encodeRun, for when the entries have colors: adds the escape codes
+  // where the color changes, and resets a background color before a
+  // separator. out must have room for size * (stride + colorroom) bytes: a
+  // byte gets at most one code and one reset, since no reset is needed after
+  // a color without background.
+  size_t encodeColoredRun(const unsigned char* in, size_t size, PrintPosition* at, char* out, size_t* outsize) const {
+    const char* data = table.data.data();
+    char* begin = out;
+    size_t i = 0;
+    while(i < size) {
+      unsigned char c = in[i++];
+      int color = table.color[c];
+      if(color != at->colornow) {
+        if(needsReset(at->colornow, color)) {
+          memcpy(out, COLOR_RESET, 4);
+          out += 4;
+        }
+        if(color >= 0) {
+          memcpy(out, colorcodes[color].data(), colorcodes[color].size());
+          out += colorcodes[color].size();
+        }
+        at->colornow = color;
+      }
+      size_t len = table.len[c] - table.separator;
+      memcpy(out, data + c * table.stride, len);
+      out += len;
+      if(table.separator) {
+        if(at->colornow >= 0 && colorbackground[at->colornow]) {
+          memcpy(out, COLOR_RESET, 4);
+          out += 4;
+          at->colornow = -1;
+        }
+        memcpy(out, data + c * table.stride + len, table.separator);
+        out += table.separator;
+      }
+      if(table.newline[c]) break;
+    }
+    *outsize = out - begin;
+    return i;
+  }
+
+  typedef void (Printer::*FeedFunction)(const unsigned char* in, size_t size, PrintPosition* at, std::string* out) const;
+
+  // Like feed, for the byte table without colors: does what beforeByte does
+  // for every line and encodes the runs straight into out, which is only
+  // resized once per call if the estimate of the lines holds. Specialized on
+  // WRAP (wrap > 0) and LINENUMBERS, so that the loop over the lines does only
+  // what those need.
+  template<bool WRAP, bool LINENUMBERS>
+  void feedTable(const unsigned char* in, size_t size, PrintPosition* at, std::string* out) const {
+    std::string open = at->offset == 0 ? n->open() : "";
+    std::string lineend = WRAP ? n->lineend() + (n->allowlinebreaks() ? "\n" : "") : "";
+    std::string linebeg = WRAP ? n->linebeg() : "";
+    // room for a line start: its line number with ": " and the open
+    size_t linesize = lineend.size() + linebeg.size() + (LINENUMBERS ? 22 : 0) + open.size();
+    size_t lines = WRAP ? size / wrap + 2 : 1; // more if there are newlines
+    size_t pos = out->size();
+    out->resize(pos + size * table.stride + lines * linesize);
+    char* o = &(*out)[pos];
+    for(size_t i = 0; i < size;) {
+      bool wrapped = WRAP && at->numbytes >= wrap;
+      if(wrapped) at->numbytes = 0;
+      size_t end = WRAP ? std::min(size, i + (wrap - at->numbytes)) : size;
+      size_t written = o - out->data();
+      if(out->size() - written < linesize + (end - i) * table.stride) {
+        out->resize(std::max(out->size() * 2, written + linesize + (end - i) * table.stride));
+        o = &(*out)[written];
+      }
+      if(wrapped) {
+        memcpy(o, lineend.data(), lineend.size());
+        o += lineend.size();
+      }
+      if(LINENUMBERS && at->numbytes == 0) {
+        o += format_uint(startoffset + at->offset, linenumbersbase == 16, lnlen, o);
+        *o++ = ':';
+        *o++ = ' ';
+      }
+      if(at->offset == 0) {
+        memcpy(o, open.data(), open.size());
+        o += open.size();
+      }
+      if(wrapped) {
+        memcpy(o, linebeg.data(), linebeg.size());
+        o += linebeg.size();
+      }
+      size_t used = 0;
+      if(usepattern) {
+        used = patternencoder.encode(in + i, end - i, o);
+        o += used * patternencoder.stride;
+      }
+      if(used < end - i) {
+        size_t runsize = 0;
+        used += (this->*encoderun)(in + i + used, end - i - used, o, &runsize);
+        o += runsize;
+      }
+      if(WRAP && table.newline[in[i + used - 1]]) at->numbytes = 1;
+      else at->numbytes += used;
+      i += used;
+      at->offset += used;
+    }
+    out->resize(o - out->data());
+  }
+
+  // end of the bytes from i on that can be encoded at once: until the next
+  // wrap, but limited to not overallocate the output too much
+  size_t runEnd(size_t i, size_t size, const PrintPosition& at) const {
+    size_t end = std::min(size, i + 65536);
+    if(wrap > 0) end = std::min(end, i + (wrap - at.numbytes));
+    else if(wrap < 0) end = i + 1;
+    return end;
+  }
+
+  // Starts encoding a stream: configure the Printer first, then call begin,
+  // then feed with the parts of the input and then finish. Since some formats
+  // need to know the next byte, the output of the last byte of a part may only
+  // be given with the next part.
+  void begin() {
+    usetable = !reference && initTable();
+    useblock = !usetable && !reference && !mix && !colored && !comma && !n->space() && n->blockencode();
+    if(usetable) encoderun = runFunction();
+    tablefeed = 0;
+    if(usetable && !table.colored && wrap >= 0) {
+      if(wrap > 0) tablefeed = printlinenumbers ? &Printer::feedTable<true, true> : &Printer::feedTable<true, false>;
+      else tablefeed = printlinenumbers ? &Printer::feedTable<false, true> : &Printer::feedTable<false, false>;
+    }
+    size_t outwidth = 0;
+    int color = 0;
+    FormatState state;
+    newlinereset = usetable ? table.newline[10] : (encodeGlyph(10, 0, 0, &outwidth, &color, &state) == "\n");
+    char digits[20];
+    lnlen = format_uint(startoffset + totalsize, linenumbersbase == 16, 0, digits);
+    at = PrintPosition();
+  }
+
+  // encodes the next size bytes of the input, appending to out
+  void feed(const char* s, size_t size, std::string* out) {
+    feed(s, size, &at, out);
+  }
+
+  // ends the stream, appending the remaining output to out
+  void finish(std::string* out) {
+    if(at.held) encodeByte(at.heldbyte, 0, &at, out);
+    at.held = false;
+    setColor(-1, &at, out);
+    if(at.offset == 0) *out += n->open(); // empty input, e.g. "" for strings
+    *out += n->close(at.state);
+  }
+
+  // encodes the next size bytes of the input from the position at
+  void feed(const char* s, size_t size, PrintPosition* at, std::string* out) const {
+    const unsigned char* in = (const unsigned char*)s;
+    if(!usetable && !useblock) {
+      // hold back the last byte until the byte after it is known
+      for(size_t i = 0; i < size; i++) {
+        if(at->held) encodeByte(at->heldbyte, in[i], at, out);
+        at->heldbyte = in[i];
+        at->held = true;
+      }
+      return;
+    }
+    if(tablefeed) {
+      (this->*tablefeed)(in, size, at, out);
+      return;
+    }
+    for(size_t i = 0; i < size;) {
+      beforeByte(at, out);
+      size_t end = runEnd(i, size, *at);
+      size_t used = 0;
+      if(usetable && table.colored) {
+        size_t pos = out->size();
+        out->resize(pos + (end - i) * (table.stride + colorroom));
+        size_t outsize = 0;
+        used = encodeColoredRun(in + i, end - i, at, &(*out)[pos], &outsize);
+        out->resize(pos + outsize);
+        if(table.newline[in[i + used - 1]]) at->numbytes = 1;
+        else at->numbytes += used;
+      } else if(usetable) {
+        size_t pos = out->size();
+        out->resize(pos + (end - i) * table.stride);
+        size_t outsize = 0;
+        if(usepattern) {
+          used = patternencoder.encode(in + i, end - i, &(*out)[pos]);
+          outsize = used * patternencoder.stride;
+        }
+        if(used < end - i) {
+          size_t runsize = 0;
+          used += (this->*encoderun)(in + i + used, end - i - used, &(*out)[pos + outsize], &runsize);
+          outsize += runsize;
+        }
+        out->resize(pos + outsize);
+        if(table.newline[in[i + used - 1]]) at->numbytes = 1;
+        else at->numbytes += used;
+      } else {
+        n->encodeBlock(in + i, end - i, &at->state, out);
+        used = end - i;
+        at->numbytes += used;
+      }
+      i += used;
+      at->offset += used;
+    }
+  }
+
+  std::string encode(const std::string& s) {
+    std::string result;
+    totalsize = s.size();
+    begin();
+    // the exact size is only cheap to get with the byte table, else it's
+    // computed by encoding
+    if(usetable && !table.colored) result.reserve(encodedSize(s.data(), s.size()));
+    feed(s.data(), s.size(), &result);
+    finish(&result);
+    return result;
+  }
+
+  // Computes the exact size of the output of encoding the whole input s,
+  // from the sizes of the byte table entries, the amount of lines and the
+  // open and close; or if there is no byte table or it has colors, by
+  // encoding in blocks and only counting. Sets totalsize and starts a new
+  // stream like begin.
+  size_t encodedSize(const char* s, size_t size) {
+    totalsize = size;
+    begin();
+    size_t result = 0;
+    if(!usetable || table.colored) {
+      std::string out;
+      for(size_t i = 0; i < size; i += BLOCK_SIZE) {
+        out.clear();
+        feed(s + i, std::min(BLOCK_SIZE, size - i), &out);
+        result += out.size();
+      }
+      out.clear();
+      finish(&out);
+      begin();
+      return result + out.size();
+    }
+    const unsigned char* in = (const unsigned char*)s;
+    size_t count[256] = {0};
+    for(size_t i = 0; i < size; i++) count[in[i]]++;
+    for(int c = 0; c < 256; c++) result += count[c] * table.len[c];
+    size_t wraps, lines;
+    countLines(s, size, &wraps, &lines);
+    result += wraps * (n->lineend().size() + (n->allowlinebreaks() ? 1 : 0) + n->linebeg().size());
+    if(printlinenumbers) result += lines * (lnlen + 2);
+    result += n->open().size();
+    FormatState end;
+    end.num = size;
+    result += n->close(end).size();
+    return result;
+  }
+
+  // Encodes the bytes from begin to end of the whole input s, which has
+  // totalsize bytes, such that the outputs of consecutive parts together give
+  // the same as encoding all at once. begin must be a multiple of the format's
+  // groupsize and, when wrapping by output width, 0. Call begin first. Does
+  // not change this Printer, so parts can be encoded by multiple threads.
+  void encodePart(const char* s, size_t begin, size_t end, std::string* out) const {
+    PrintPosition part;
+    part.offset = begin;
+    part.numbytes = wrapCount(s, begin);
+    part.prevbyte = begin ? s[begin - 1] : 0;
+    part.state.num = begin;
+    part.colornow = colorBefore(s, begin);
+    feed(s + begin, end - begin, &part, out);
+    if(part.held) encodeByte(part.heldbyte, end < totalsize ? s[end] : 0, &part, out);
+    if(end == totalsize) {
+      setColor(-1, &part, out);
+      if(end == 0) *out += n->open();
+      *out += n->close(part.state);
+    }
+  }
+
+  // Encodes the whole input with numthreads threads, in parts that are
+  // written to out in order. Falls back to one thread if the format and
+  // settings don't allow splitting the input.
+  void encodeThreaded(const char* s, size_t size, size_t numthreads, OutputFile* out) {
+    totalsize = size;
+    begin();
+    // preallocate the output file if its size is quick to know
+    if(out->regular && usetable && !table.colored) out->reserve(encodedSize(s, size));
+    if(numthreads <= 1 || (wrap > 0 && wrapsByOutput())) {
+      for(size_t i = 0; i < size; i += BLOCK_SIZE) {
+        feed(s + i, std::min(BLOCK_SIZE, size - i), &out->buffer);
+        out->flushIfFull();
+      }
+      finish(&out->buffer);
+      return;
+    }
+    // parts start at the beginning of a line, and of a group
+    size_t align = n->groupsize() * (wrap > 0 ? wrap : 1);
+    size_t partsize = std::max<size_t>(size / (numthreads * 4), minpartsize);
+    partsize = (partsize + align - 1) / align * align;
+    size_t numparts = std::max<size_t>(1, (size + partsize - 1) / partsize);
+    run_parts(numparts, numthreads, [&](size_t k, std::string* part) {
+      encodePart(s, k * partsize, std::min(size, (k + 1) * partsize), part);
+    }, [&](size_t k, std::string* part) {
+      out->write(*part);
+      return true;
+    });
+  }
+
+  // Starts decoding a stream, which then goes like encoding, with decodeFeed
+  // and decodeFinish.
+  void decodeBegin() {
+    if(decodesTokens()) initTokenPattern();
+    decoding = decodeStart(0);
+  }
+
+  // Decodes the next size characters of the text. What the Printer itself
+  // adds when encoding is skipped here: line numbers with printlinenumbers
+  // and color escape codes with colored. The format gets the text in between,
+  // including the newlines and its own line begin and end. The skipped
+  // characters are counted in the position of the state, so that messages
+  // give positions in the whole text.
+  void decodeFeed(const char* s, size_t size, std::string* out) {
+    decodeFeed(s, size, &decoding, out);
+  }
+
+  void decodeFinish(std::string* out) {
+    decodeFinish(&decoding, out);
+  }
+
+  // decodes the next size characters of the text from the position at
+  void decodeFeed(const char* s, size_t size, DecodePosition* at, std::string* out) const {
+    if(!printlinenumbers && !colored) {
+      decodeText(s, size, at, out);
+      return;
+    }
+    size_t i = 0;
+    while(i < size) {
+      char c = s[i];
+      if(at->inescape) {
+        // an escape code ends with a letter
+        if((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) at->inescape = false;
+        i++;
+        at->state.num++;
+      } else if(colored && c == 27) {
+        at->inescape = true;
+        i++;
+        at->state.num++;
+      } else if(at->skipping == 1) {
+        // the line number, right aligned with spaces, ends with ':'
+        if(c == ':') at->skipping = 2;
+        i++;
+        at->state.num++;
+      } else if(at->skipping == 2) {
+        if(c == ' ') {
+          i++;
+          at->state.num++;
+        }
+        at->skipping = 0;
+      } else {
+        size_t end = i;
+        if(!colored) {
+          end = split_after_newline(s, size, i);
+        } else {
+          while(end < size && s[end] != 27 && !(printlinenumbers && s[end] == '\n')) end++;
+          if(end < size && s[end] == '\n') end++;
+        }
+        if(printlinenumbers && s[end - 1] == '\n') at->skipping = 1;
+        decodeText(s + i, end - i, at, out);
+        i = end;
+      }
+    }
+  }
+
+  // ends the decode stream of the position at
+  void decodeFinish(DecodePosition* at, std::string* out) const {
+    if(!mix) {
+      n->decodeFinish(&at->state, out);
+    } else if(!at->token.empty()) {
+      decodeToken(at->token.data(), at->token.size(), at->state.num - at->token.size(), &at->state, out);
+      at->token.clear();
+    }
+  }
+
+  // Decodes the part from begin to end of the whole text s of size bytes,
+  // starting from a new position at begin. Gives the position after it in
+  // *endpos, with the diagnostics of the part: the next part only decoded
+  // correctly if that is clean (see decodeClean). Does not change this
+  // Printer.
+  void decodePart(const char* s, size_t size, size_t begin, size_t end, std::string* out, DecodePosition* endpos) const {
+    *endpos = decodeStart(begin);
+    decodeFeed(s + begin, end - begin, endpos, out);
+    if(end == size) decodeFinish(endpos, out);
+  }
+
+  // whether decoding on from the position at, at the start of a line, gives
+  // the same as from a new position there. Damaged text may leave an escape
+  // code or a line number unfinished.
+  bool decodeClean(const DecodePosition& at) const {
+    if(at.inescape || at.skipping != (printlinenumbers ? 1 : 0) || !at.token.empty()) return false;
+    return decodesTokens() || n->decodeClean(at.state);
+  }
+
+  // Decodes the whole text with numthreads threads, in parts split where the
+  // format allows it, written to out in order, and the diagnostics to
+  // messages. In malformed input where a value, escape code or line number
+  // is cut in two at a split, the rest is decoded with one thread: the parts
+  // from there on are dropped along with their diagnostics, which may be
+  // wrong for such a part.
+  void decodeThreaded(const char* s, size_t size, size_t numthreads, OutputFile* out, std::ostream* messages) {
+    std::vector<size_t> splits(1, 0);
+    if(numthreads > 1) {
+      size_t partsize = std::max<size_t>(size / (numthreads * 4), minpartsize);
+      while(splits.back() < size) {
+        size_t pos = std::min(size, splits.back() + partsize);
+        if(pos < size) pos = decodesTokens() ? split_after_space(s, size, pos) : n->decodeSplit(s, size, pos);
+        // parts start at a line, where decodeBegin expects a line number
+        if(pos < size && (printlinenumbers || colored)) pos = split_after_newline(s, size, pos);
+        splits.push_back(pos);
+      }
+    }
+    decodeBegin();
+    size_t numparts = splits.size() - 1;
+    size_t rest = 0; // where decoding with one thread starts
+    if(numparts > 1) {
+      std::vector<DecodePosition> ends(numparts);
+      rest = size;
+      run_parts(numparts, numthreads, [&](size_t k, std::string* part) {
+        decodePart(s, size, splits[k], splits[k + 1], part, &ends[k]);
+      }, [&](size_t k, std::string* part) {
+        if(k > 0 && !decodeClean(ends[k - 1])) {
+          decoding = ends[k - 1];
+          decoding.state.messages.clear(); // given with the part before
+          rest = splits[k];
+          return false;
+        }
+        *messages << ends[k].state.messages << std::flush;
+        out->write(*part);
+        return true;
+      });
+      if(rest == size) return;
+    }
+    // feeds at least once, for formats that report they can't decode
+    size_t i = rest;
+    do {
+      decodeFeed(s + i, std::min(BLOCK_SIZE, size - i), &out->buffer);
+      *messages << takeMessages() << std::flush;
+      out->flushIfFull();
+      i += BLOCK_SIZE;
+    } while(i < size);
+    decodeFinish(&out->buffer);
+    *messages << takeMessages() << std::flush;
+  }
+
+  // takes the diagnostics that decoding gave so far, a line each
+  std::string takeMessages() {
+    std::string result;
+    result.swap(decoding.state.messages);
+    return result;
+  }
+
+  std::string decode(const std::string& s) {
+    std::string result;
+    decodeBegin();
+    decodeFeed(s.data(), s.size(), &result);
+    decodeFinish(&result);
+    return result;
+  }
+
+  std::string getTable() {
+    std::string digits = "0123456789abcdef";
+    int size = n->width() + 1;
+    std::string table = "   ";
+    for(int i = 0; i < 16; i++) {
+      table += digits[i];
+      for(int j = 1; j < size; j++) table += ' ';
+    }
+    table += '\n';
+    table += " +";
+    for(int i = 0; i < 16 * size; i++) {
+      table += '-';
+    }
+    table += '\n';
+    for(int y = 0; y < 16; y++) {
+      table += digits.substr(y, 1) + "|";
+      for(int x = 0; x < 16; x++) {
+        unsigned char c = y * 16 + x;
+        size_t outwidth = 0;
+        std::string s = encodeChar(c, 0, 0, &outwidth);
+        if(s == "\n") {
+          s = "";
+          for(size_t j = 1; j < size; j++) s += " ";
+        }
+        while(s.size() < n->width()) s = " " + s;
+        table += std::string(" ") + s;
+      }
+      table += "\n";
+    }
+    return table;
+  }
+
+  Format* n;
+
+  int wrap = 0;
+  size_t totalsize = 0; // size of the whole input if known, to align line numbers
+  size_t startoffset = 0; // offset in the file of the input, added to line numbers
+  bool printlinenumbers = false;
+  int linenumbersbase = 10;
+  bool colored = false;
+  bool comma = false;
+  bool mix = false;
+  bool printnewline = false;
+  bool printspace = false;
+  bool lsb_first = false;
+  bool inputwrap = false; // wrap by input bytes also for formats that align by output width
+  bool reference = false; // encode byte by byte with encodeChar, without the table or blocks, to test them against
+  size_t minpartsize = 1048576; // least input per part when using threads, smaller to test the splits
+
+  ByteTable table; // built on first encode, see initTable
+  PatternEncoder patternencoder;
+  bool usepattern = false;
+
+ private:
+  bool wrapsByOutput() const {
+    return n->outwidth() && !inputwrap;
+  }
+
+  // adds what comes before the next byte: the end of the previous line when
+  // wrapping, the line number and the open of the format
+  void beforeByte(PrintPosition* at, std::string* out) const {
+    bool wrapped = false;
+    if(wrap && at->numbytes >= wrap) {
+      setColor(-1, at, out);
+      *out += n->lineend();
+      if(n->allowlinebreaks()) *out += "\n";
+      at->numbytes = 0;
+      wrapped = true;
+    }
+    if(printlinenumbers && at->numbytes == 0) {
+      setColor(-1, at, out);
+      append_uint(startoffset + at->offset, linenumbersbase == 16, lnlen, out);
+      out->append(": ", 2);
+    }
+    if(at->offset == 0) *out += n->open();
+    if(wrapped) *out += n->linebeg();
+  }
+
+  // Counts the wraps and the line starts (where a line number goes) when
+  // encoding the size bytes of s, as beforeByte does them.
+  void countLines(const char* s, size_t size, size_t* wraps, size_t* lines) const {
+    *wraps = *lines = 0;
+    if(size == 0) return;
+    if(wrap < 0) {
+      *wraps = *lines = size;
+      return;
+    }
+    if(wrap == 0) {
+      *lines = 1;
+      return;
+    }
+    // The wrap counter starts at 0, and at 1 after a byte that encodes as a
+    // newline. From 0 the first wrap is before byte wrap, from 1 before byte
+    // wrap - 1.
+    size_t start = 0;
+    bool first = true;
+    for(;;) {
+      const char* nl = newlinereset ? (const char*)memchr(s + start, 10, size - start) : 0;
+      size_t end = nl ? nl - s + 1 : size;
+      size_t w = first ? (end - start - 1) / wrap : (end - start) / wrap;
+      *wraps += w;
+      *lines += w + (first ? 1 : 0);
+      if(end == size) break;
+      start = end;
+      first = false;
+    }
+  }
+
+  // the wrap counter numbytes of PrintPosition as it is after encoding the first pos bytes of
+  // s, for when the input is split in parts. Wrapping by output width is not
+  // supported.
+  size_t wrapCount(const char* s, size_t pos) const {
+    if(pos == 0) return 0;
+    if(wrap <= 0) return 1; // only compared to 0, or to negative wrap
+    // the bytes are counted from the last byte that encodes as a newline
+    size_t origin = 0;
+    if(newlinereset) {
+      const void* nl = memrchr(s, 10, pos);
+      if(nl) origin = (const char*)nl - s;
+    }
+    return (pos - origin - 1) % wrap + 1;
+  }
+
+  // the color that the output is in after encoding the first pos bytes of s,
+  // for when the input is split in parts. Encodes the bytes of the group
+  // before pos again, since their glyph may depend on the earlier ones.
+  int colorBefore(const char* s, size_t pos) const {
+    if(pos == 0) return -1;
+    const unsigned char* in = (const unsigned char*)s;
+    size_t groupsize = n->groupsize();
+    size_t begin = (pos - 1) / groupsize * groupsize;
+    FormatState state;
+    state.num = begin;
+    size_t outwidth = 0;
+    int color = -1;
+    for(size_t i = begin; i < pos; i++) {
+      encodeGlyph(in[i], i ? in[i - 1] : 0, i + 1 < totalsize ? in[i + 1] : 0, &outwidth, &color, &state);
+    }
+    // a background is reset before the separator
+    if((comma || n->space()) && color >= 0 && colorbackground[color]) return -1;
+    return color;
+  }
+
+  // whether changing from colornow to color needs a reset first: a new code
+  // replaces the foreground color, but not a background color
+  bool needsReset(int colornow, int color) const {
+    if(colornow < 0) return false;
+    return color < 0 || (colorbackground[colornow] && !colorbackground[color]);
+  }
+
+  // changes the color of the output to color, which may be -1 for none
+  void setColor(int color, PrintPosition* at, std::string* out) const {
+    if(color == at->colornow) return;
+    if(needsReset(at->colornow, color)) *out += COLOR_RESET;
+    if(color >= 0) *out += colorcodes[color];
+    at->colornow = color;
+  }
+
+  // Builds the escape codes of colorcodes: with index 0-15 for --color, by
+  // the high hex digit of a byte, and 16 + byte for formats that color bytes
+  // themselves.
+  void initColors() {
+    colorcodes.resize(16 + 256);
+    colorbackground.assign(16 + 256, 1);
+    // the gray values (7, 8, 15) are unused in case standard color for printable ASCII is used
+    static const int colors[16] = {1,  2,  3, 7, 15, 8, 15,  4,
+                                   9, 10, 11, 5, 13, 6, 14, 12};
+    for(int i = 0; i < 16; i++) {
+      int color = colors[i];
+      colorcodes[i] = "\x1b[" + valtostr((color < 8 ? 30 : 82) + color) + "m";
+      // dark blue is quite unreadable against black background, so give it a background. Also
+      // give background to the one duplicate color to distinguish it.
+      // This assumes terminal with white-ish text on black background
+      colorbackground[i] = (color == 4 || i == 6);
+      if(colorbackground[i]) colorcodes[i] += "\x1b[100m";
+    }
+    // the codes of formats are taken to set the background
+    for(int c = 0; c < 256; c++) colorcodes[16 + c] = n->colorcode(c);
+    colorroom = 0;
+    for(size_t i = 0; i < colorcodes.size(); i++) {
+      colorroom = std::max(colorroom, colorcodes[i].size() + 4);
+    }
+  }
+
+  // encodes a single byte, for formats that need to know the bytes around it
+  void encodeByte(unsigned char c, unsigned char next, PrintPosition* at, std::string* out) const {
+    beforeByte(at, out);
+    size_t outwidth = 0;
+    int color;
+    std::string temp = encodeGlyph(c, at->prevbyte, next, &outwidth, &color, &at->state);
+    setColor(color, at, out);
+    *out += temp;
+    if(comma || n->space()) {
+      // the separator has no background color
+      if(at->colornow >= 0 && colorbackground[at->colornow]) setColor(-1, at, out);
+      if(comma) *out += ",";
+      *out += " ";
+    }
+    if(temp == "\n") {
+      at->numbytes = 0;
+    }
+    if(wrapsByOutput()) {
+      // For C string literals, with variable length characters, align the width
+      // based on the output width rather than the input width.
+      at->numbytes += outwidth;
+    } else {
+      at->numbytes++;
+    }
+    at->prevbyte = c;
+    at->offset++;
+  }
+
+  // whether decoding is by whitespace separated tokens, for mix, which
+  // formats that are printable themselves don't use
+  bool decodesTokens() const {
+    return mix && !n->printable();
+  }
+
+  // the position at pos in the text, at the start of a decode stream or of a
+  // part of one
+  DecodePosition decodeStart(size_t pos) const {
+    DecodePosition result;
+    result.state.num = pos;
+    // glyphs and strings skip the ", " after every byte, hex and base64 allow
+    // its comma, other numbers are decoded from their digits anyway
+    if(comma) result.state.separator = 2;
+    result.skipping = printlinenumbers ? 1 : 0;
+    return result;
+  }
+
+  // decodes text without line numbers or color codes
+  void decodeText(const char* s, size_t size, DecodePosition* at, std::string* out) const {
+    if(!decodesTokens()) {
+      n->decodeFeed(s, size, &at->state, out);
+      return;
+    }
+    // tokens are decoded where they are in s, only one that the part ends in
+    // is kept in token until the rest of it comes. 32 is space, anything <= 32
+    // is considered whitespace
+    out->reserve(out->size() + size / 2 + 1);
+    size_t i = 0;
+    std::string& token = at->token;
+    size_t num = at->state.num; // position of s
+    at->state.num += size;
+    if(!token.empty()) {
+      while(i < size && s[i] > 32) i++;
+      size_t pos = num - token.size();
+      token.append(s, i);
+      if(i == size) return;
+      decodeToken(token.data(), token.size(), pos, &at->state, out);
+      token.clear();
+    }
+    for(;;) {
+      while(i < size && s[i] <= 32) i++;
+      size_t begin = i;
+      while(i < size && s[i] > 32) i++;
+      if(i == size) {
+        token.assign(s + begin, i - begin);
+        return;
+      }
+      decodeToken(s + begin, i - begin, num + begin, &at->state, out);
+    }
+  }
+
+  // decodes the mix mode token t, which is a printable character as itself or
+  // else a value in the format, at position pos of the text. Values that
+  // match the byte pattern of the format are decoded here, others by the
+  // format, with the messages added to state.
+  void decodeToken(const char* t, size_t size, size_t pos, FormatState* state, std::string* out) const {
+    if(comma && size > 1 && t[size - 1] == ',') size--;
+    if(size == 1 && t[0] > 32 && t[0] < 127) {
+      out->push_back(t[0]);
+    } else if(!decodePatternToken(t, size, out)) {
+      FormatState tokenstate;
+      tokenstate.num = pos;
+      n->decodeFeed(t, size, &tokenstate, out);
+      n->decodeFinish(&tokenstate, out);
+      state->messages += tokenstate.messages;
+    }
+  }
+
+  // sets up tokenpattern and tokendigits for decodePatternToken, if the
+  // format has a NIBBLES byte pattern
+  void initTokenPattern() {
+    tokenpattern.clear();
+    BytePattern pattern = n->bytepattern();
+    if(pattern.kind != BytePattern::NIBBLES) return;
+    tokenpattern = pattern.pattern;
+    for(size_t i = 0; i < 256; i++) tokendigits[i] = -1;
+    // the format decodes the digits in either case
+    for(int i = 0; i < 16; i++) {
+      unsigned char c = pattern.digits[i];
+      tokendigits[c] = i;
+      if(c >= 'a' && c <= 'z') tokendigits[c - 'a' + 'A'] = i;
+      if(c >= 'A' && c <= 'Z') tokendigits[c - 'A' + 'a'] = i;
+    }
+  }
+
+  // decodes the token t if it is exactly one value of tokenpattern, returns
+  // whether it was
+  bool decodePatternToken(const char* t, size_t size, std::string* out) const {
+    if(size != tokenpattern.size() || size == 0) return false;
+    int v = 0;
+    for(size_t i = 0; i < size; i++) {
+      char p = tokenpattern[i];
+      if(p == 1 || p == 2) {
+        int d = tokendigits[(unsigned char)t[i]];
+        if(d < 0) return false;
+        v |= d << (p == 1 ? 4 : 0);
+      } else if(t[i] != p) {
+        return false;
+      }
+    }
+    out->push_back(v);
+    return true;
+  }
+
+  bool usetable = false;
+  bool useblock = false;
+  RunFunction encoderun = 0; // the encodeRun for the table, see runFunction
+  FeedFunction tablefeed = 0; // the feedTable for the settings, if feed can use one
+  size_t lnlen = 0; // width of the line numbers
+  std::vector<std::string> colorcodes; // escape codes that set a color, see initColors
+  std::vector<char> colorbackground; // whether the color code sets the background
+  size_t colorroom = 0; // longest color change, a reset and a color code
+  bool newlinereset = false; // whether byte 10 encodes as a newline, which resets the wrap counter
+  PrintPosition at; // of the stream of begin, feed and finish
+  DecodePosition decoding; // of the stream of decodeBegin, decodeFeed and decodeFinish
+  std::string tokenpattern; // the byte pattern of tokens decodePatternToken decodes, empty if none
+  signed char tokendigits[256] = {}; // value of each digit of tokenpattern, or -1
+};
+
+// Inverse of a table of 256 glyphs, which decodes them straight from their
+// UTF-8 bytes with array lookups: for 1 and 2 byte sequences directly, for 3
+// byte sequences with a page per lead byte and second byte. Only code points
+// below U+10000 are supported, which is all the tables use.
+class GlyphDecoder {
+ public:
+  GlyphDecoder(const int table[256]) : pages(1024, 0), leaves(64, (short)INVALID) {
+    for(int i = 0; i < 128; i++) one[i] = INVALID;
+    for(int i = 0; i < 2048; i++) two[i] = INVALID;
+    one[10] = SKIP;
+    for(int c = 0; c < 256; c++) {
+      bool added = add(table[c], c);
+      assert(added); // the tables have no duplicates
+      (void)added;
+    }
+  }
+
+  // also decodes code_point as c, returns false if it already decoded as
+  // something
+  bool add(int code_point, unsigned char c) {
+    short* entry;
+    if(code_point < 128) {
+      entry = &one[code_point];
+    } else if(code_point < 2048) {
+      entry = &two[code_point];
+    } else {
+      unsigned char& page = pages[code_point >> 6];
+      if(!page) {
+        page = leaves.size() / 64;
+        leaves.resize(leaves.size() + 64, (short)INVALID);
+      }
+      entry = &leaves[page * 64 + (code_point & 63)];
+    }
+    if(*entry != INVALID) return false;
+    *entry = c;
+    return true;
+  }
+
+  // Decodes UTF-8 text of glyphs in parts: an UTF-8 sequence cut off at the
+  // end of a part is kept in the state until the next one, or until final.
+  // Newlines are skipped, as is the separator of comma after every glyph.
+  // The state counts the bytes of text in num, for error messages.
+  void decode(const char* s, size_t size, bool final, FormatState* state, std::string* out) const {
+    std::string& pending = state->pending;
+    size_t i = 0;
+    // complete a sequence from the previous part byte per byte, the rest of
+    // an invalid one may be the separator to skip
+    while(!pending.empty()) {
+      if(state->skip > 0) {
+        size_t n = std::min<size_t>(state->skip, pending.size());
+        pending.erase(0, n);
+        state->num += n;
+        state->skip -= n;
+        continue;
+      }
+      int code_point;
+      size_t used = utf8_decode_one((const uint8_t*)pending.data(), pending.size(), !final, &code_point);
+      if(!used) {
+        if(i == size) return;
+        pending += s[i++];
+        continue;
+      }
+      pending.erase(0, used);
+      put(code_point, used, state, out);
+    }
+    const unsigned char* in = (const unsigned char*)s;
+    size_t pos = out->size();
+    out->resize(pos + size - i); // every glyph is at least one byte
+    char* o = &(*out)[pos];
+    size_t num = state->num;
+    int skip = state->skip;
+    while(i < size) {
+      if(skip > 0) {
+        size_t n = std::min<size_t>(skip, size - i);
+        i += n;
+        num += n;
+        skip -= n;
+        continue;
+      }
+      unsigned char b0 = in[i];
+      int v = INVALID;
+      size_t used = 1;
+      if(b0 < 128) {
+        v = one[b0];
+      } else if(b0 >= 0xc2 && b0 < 0xe0 && i + 1 < size && (in[i + 1] & 0xc0) == 0x80) {
+        v = two[((b0 & 31) << 6) | (in[i + 1] & 63)];
+        used = 2;
+      } else if(b0 >= 0xe0 && b0 < 0xf0 && i + 2 < size && (in[i + 1] & 0xc0) == 0x80 && (in[i + 2] & 0xc0) == 0x80) {
+        // overlong sequences fall in pages below U+0800, which are never used
+        v = leaves[pages[((b0 & 15) << 6) | (in[i + 1] & 63)] * 64 + (in[i + 2] & 63)];
+        used = 3;
+      }
+      if(v >= 0) {
+        *o++ = v;
+        skip = state->separator;
+      } else if(v == INVALID) {
+        // slow path for invalid, 4 byte and cut off sequences
+        int code_point;
+        used = utf8_decode_one(in + i, size - i, !final, &code_point);
+        if(!used) {
+          pending.assign(s + i, size - i);
+          break;
+        }
+        report(state, "invalid character: " + std::to_string(code_point) + " at " + std::to_string(num));
+        *o++ = '?';
+        skip = state->separator;
+      }
+      i += used;
+      num += used;
+    }
+    state->num = num;
+    state->skip = skip;
+    out->resize(o - out->data());
+  }
+
+ private:
+  static const short INVALID = -1;
+  static const short SKIP = -2;
+
+  // outputs the byte of one code point of size bytes of text
+  void put(int code_point, size_t size, FormatState* state, std::string* out) const {
+    int v = INVALID;
+    if(code_point < 128) v = one[code_point];
+    else if(code_point < 2048) v = two[code_point];
+    else if(code_point < 65536) v = leaves[pages[code_point >> 6] * 64 + (code_point & 63)];
+    if(v >= 0) {
+      out->push_back(v);
+    } else if(v == INVALID) {
+      report(state, "invalid character: " + std::to_string(code_point) + " at " + std::to_string(state->num));
+      out->push_back('?');
+    }
+    if(v != SKIP) state->skip = state->separator;
+    state->num += size;
+  }
+
+  short one[128];
+  short two[2048];
+  std::vector<unsigned char> pages; // leaf for each code point >> 6, 0 if none
+  std::vector<short> leaves; // 64 entries each, the first for unused pages
+};
+
+class CP437 : public Format {
+ public:
+  CP437(bool newline, bool printnull, bool comma = false) : newline(newline), printnull(printnull), comma(comma), glyphs(table437) {
+  }
+
+  virtual bool contextfree() const { return true; }
+
+  virtual bool printable() const { return true; }
+
+  std::string encodeChar(unsigned char c, unsigned char prev, unsigned char next, FormatState* state) {
+    if(newline && c == 10) return "\n";
+    if(printnull && c == 0) return " ";
+    return unicode_to_string({table437[c]});
+  }
+
+  virtual void decodeFeed(const char* s, size_t size, FormatState* state, std::string* out) {
+    if(newline || printnull) return;
+    glyphs.decode(s, size, false, state, out);
+  }
+
+  virtual void decodeFinish(FormatState* state, std::string* out) {
+    if(newline) report(state, "decoding is not supported with printnewline enabled");
+    else if(printnull) report(state, "decoding is not supported with printnull enabled");
+    else glyphs.decode(0, 0, true, state, out);
+  }
+
+  virtual size_t decodeSplit(const char* s, size_t size, size_t pos) const {
+    if(newline || printnull) return size;
+    // a split in the ", " after a glyph would make the next part skip glyphs
+    if(comma) return split_after_separator(s, size, pos);
+    return split_utf8(s, size, pos);
+  }
+
+  bool newline;
+  bool printnull;
+  bool comma;
+
+ private:
+  GlyphDecoder glyphs;
+};
+
+class CP1252 : public Format {
+ public:
+  CP1252(bool newline, bool printnull, bool comma = false) : newline(newline), printnull(printnull), comma(comma), glyphs(table1252) {
+  }
+
+  virtual bool contextfree() const { return true; }
+
+  virtual bool printable() const { return true; }
+
+  std::string encodeChar(unsigned char c, unsigned char prev, unsigned char next, FormatState* state) {
+    if(newline && c == 10) return "\n";
+    if(printnull && c == 0) return " ";
+    return unicode_to_string({table1252[c]});
+  }
+
+  virtual void decodeFeed(const char* s, size_t size, FormatState* state, std::string* out) {
+    if(newline || printnull) return;
+    glyphs.decode(s, size, false, state, out);
+  }
+
+  virtual void decodeFinish(FormatState* state, std::string* out) {
+    if(newline) report(state, "decoding is not supported with printnewline enabled");
+    else if(printnull) report(state, "decoding is not supported with printnull enabled");
+    else glyphs.decode(0, 0, true, state, out);
+  }
+
+  virtual size_t decodeSplit(const char* s, size_t size, size_t pos) const {
+    if(newline || printnull) return size;
+    // a split in the ", " after a glyph would make the next part skip glyphs
+    if(comma) return split_after_separator(s, size, pos);
+    return split_utf8(s, size, pos);
+  }
+
+  bool newline;
+  bool printnull;
+  bool comma;
+
+ private:
+  GlyphDecoder glyphs;
+};
+
+class Braille : public Format {
+ public:
+  Braille(bool newline, bool printnull, bool comma = false) : newline(newline), printnull(printnull), comma(comma), glyphs(makeDecoder()) {
+  }
+
+  virtual bool contextfree() const { return true; }
+
+  virtual BytePattern bytepattern() const {
+    BytePattern result;
+    if(newline) return result;
+    result.kind = BytePattern::BRAILLE;
+    result.pattern = "\xe2\1\2";
+    result.altnull = !printnull;
+    return result;
+  }
+
+  std::string encodeChar(unsigned char c, unsigned char prev, unsigned char next, FormatState* state) {
+    if(c == 0 && !printnull) return unicode_to_string({table437[0]});
+    if(newline && c == 10) return "\n";
+    return unicode_to_string({0x2800 + c});
+  }
+
+  virtual void decodeFeed(const char* s, size_t size, FormatState* state, std::string* out) {
+    if(newline) return;
+    glyphs.decode(s, size, false, state, out);
+  }
+
+  virtual void decodeFinish(FormatState* state, std::string* out) {
+    if(newline) report(state, "decoding is not supported with printnewline enabled");
+    else glyphs.decode(0, 0, true, state, out);
+  }
+
+  virtual size_t decodeSplit(const char* s, size_t size, size_t pos) const {
+    if(newline) return size;
+    if(comma) return split_after_separator(s, size, pos);
+    return split_utf8(s, size, pos);
+  }
+
+  bool newline;
+  bool printnull;
+  bool comma;
+
+ private:
+  // the braille patterns are U+2800 + byte, and null may also be shown as
+  // ALT_NULL
+  static GlyphDecoder makeDecoder() {
+    int table[256];
+    for(int c = 0; c < 256; c++) table[c] = 0x2800 + c;
+    GlyphDecoder result(table);
+    result.add(table437[0], 0);
+    return result;
+  }
+
+  GlyphDecoder glyphs;
+};
+
+class ASCII : public Format {
+ public:
+  ASCII(bool newline = false) : newline(newline) {
+  }
+
+  virtual bool contextfree() const { return true; }
+
+  virtual bool printable() const { return true; }
+
+  std::string encodeChar(unsigned char c, unsigned char prev, unsigned char next, FormatState* state) {
+    if(newline && c == 10) return "\n";
+    if(c > 32 && c < 127) return std::string(1, (char)c);
+    else return "?";
+  }
+
+  bool newline;
+};
+
+class Low : public Format {
+ public:
+  Low(bool newline = false, bool lower = false) : newline(newline),
+      digits(lower ? digits_lower : digits_upper)  {
+  }
+
+  virtual bool contextfree() const { return true; }
+
+  virtual BytePattern bytepattern() const {
+    BytePattern result;
+    result.kind = BytePattern::NIBBLES;
+    result.pattern = "\2";
+    result.digits = digits;
+    return result;
+  }
+
+  std::string encodeChar(unsigned char c, unsigned char prev, unsigned char next, FormatState* state) {
+    return std::string("") + digits[c & 15];
+  }
+
+  const char* digits_lower = "0123456789abcdef";
+  const char* digits_upper = "0123456789ABCDEF";
+  const char* digits;
+
+  bool newline;
+};
+
+class High : public Format {
+ public:
+  High(bool newline = false, bool lower = false) : newline(newline),
+      digits(lower ? digits_lower : digits_upper)  {
+  }
+
+  virtual bool contextfree() const { return true; }
+
+  virtual BytePattern bytepattern() const {
+    BytePattern result;
+    result.kind = BytePattern::NIBBLES;
+    result.pattern = "\1";
+    result.digits = digits;
+    return result;
+  }
+
+  std::string encodeChar(unsigned char c, unsigned char prev, unsigned char next, FormatState* state) {
+    return std::string("") + digits[(c >> 4) & 15];
+  }
+
+  const char* digits_lower = "0123456789abcdef";
+  const char* digits_upper = "0123456789ABCDEF";
+  const char* digits;
+
+  bool newline;
+};
+
+#if defined(BASE256_X86)
+// Encodes groups of 3 bytes to 4 base64 characters, 8 groups at a time
+// (after Wojciech Mula's SSSE3 algorithm, with a block of 4 groups in each
+// 128-bit lane). Stops while there are still 2 groups left, since reading 16
+// bytes for the last ones would go past the end of the input. Returns the
+// amount of groups done.
+TARGET_AVX2 inline size_t base64_encode_groups_avx2(const unsigned char* in, size_t groups, char* out) {
+  size_t g = 0;
+  const __m256i shuf2 = _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+                                         1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+  const __m256i shift2 = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                          '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                          '/' - 63, 'A', 0, 0,
+                                          'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                          '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                          '/' - 63, 'A', 0, 0);
+  for(; g + 10 <= groups; g += 8) {
+    const __m128i* p = (const __m128i*)(in + g * 3);
+    __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(p)),
+                                        _mm_loadu_si128((const __m128i*)(in + g * 3 + 12)), 1);
+    // each dword gets bytes 1, 0, 2, 1 of its group, then the 4 sextets of
+    // the group are moved to the 4 bytes of the dword
+    v = _mm256_shuffle_epi8(v, shuf2);
+    __m256i ac = _mm256_mulhi_epu16(_mm256_and_si256(v, _mm256_set1_epi32(0x0fc0fc00)), _mm256_set1_epi32(0x04000040));
+    __m256i bd = _mm256_mullo_epi16(_mm256_and_si256(v, _mm256_set1_epi32(0x003f03f0)), _mm256_set1_epi32(0x01000010));
+    __m256i values = _mm256_or_si256(ac, bd);
+    // 0-25 -> 13, 26-51 -> 0, 52-61 -> 1-10, 62 -> 11, 63 -> 12: index of
+    // the offset from value to character
+    __m256i index = _mm256_subs_epu8(values, _mm256_set1_epi8(51));
+    __m256i less = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), values);
+    index = _mm256_or_si256(index, _mm256_and_si256(less, _mm256_set1_epi8(13)));
+    __m256i chars = _mm256_add_epi8(values, _mm256_shuffle_epi8(shift2, index));
+    _mm256_storeu_si256((__m256i*)(out + g * 4), chars);
+  }
+  return g;
+}
+
+// like base64_encode_groups_avx2, 4 groups at a time
+TARGET_SSE42 inline size_t base64_encode_groups_sse(const unsigned char* in, size_t groups, char* out) {
+  size_t g = 0;
+  const __m128i shuf = _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+  const __m128i shift = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                      '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                      '/' - 63, 'A', 0, 0);
+  for(; g + 6 <= groups; g += 4) {
+    __m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(in + g * 3)), shuf);
+    __m128i ac = _mm_mulhi_epu16(_mm_and_si128(v, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+    __m128i bd = _mm_mullo_epi16(_mm_and_si128(v, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+    __m128i values = _mm_or_si128(ac, bd);
+    __m128i index = _mm_subs_epu8(values, _mm_set1_epi8(51));
+    __m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), values);
+    index = _mm_or_si128(index, _mm_and_si128(less, _mm_set1_epi8(13)));
+    __m128i chars = _mm_add_epi8(values, _mm_shuffle_epi8(shift, index));
+    _mm_storeu_si128((__m128i*)(out + g * 4), chars);
+  }
+  return g;
+}
+
+// Converts 16 base64 characters to their values, returns false if any of them
+// is not in the base64 alphabet (e.g. whitespace, padding or invalid)
+TARGET_SSE42 static inline bool base64_values(__m128i c, __m128i* values) {
+  __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('A' - 1)), _mm_cmpgt_epi8(_mm_set1_epi8('Z' + 1), c));
+  __m128i lower = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('a' - 1)), _mm_cmpgt_epi8(_mm_set1_epi8('z' + 1), c));
+  __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)), _mm_cmpgt_epi8(_mm_set1_epi8('9' + 1), c));
+  __m128i plus = _mm_cmpeq_epi8(c, _mm_set1_epi8('+'));
+  __m128i slash = _mm_cmpeq_epi8(c, _mm_set1_epi8('/'));
+  __m128i valid = _mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(_mm_or_si128(digit, plus), slash));
+  if(_mm_movemask_epi8(valid) != 0xffff) return false;
+  __m128i shift = _mm_or_si128(_mm_or_si128(_mm_and_si128(upper, _mm_set1_epi8(-'A')),
+                                            _mm_and_si128(lower, _mm_set1_epi8(26 - 'a'))),
+                               _mm_or_si128(_mm_or_si128(_mm_and_si128(digit, _mm_set1_epi8(52 - '0')),
+                                                         _mm_and_si128(plus, _mm_set1_epi8(62 - '+'))),
+                                            _mm_and_si128(slash, _mm_set1_epi8(63 - '/'))));
+  *values = _mm_add_epi8(c, shift);
+  return true;
+}
+
+TARGET_AVX2 static inline bool base64_values(__m256i c, __m256i* values) {
+  __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(c, _mm256_set1_epi8('A' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), c));
+  __m256i lower = _mm256_and_si256(_mm256_cmpgt_epi8(c, _mm256_set1_epi8('a' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), c));
+  __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(c, _mm256_set1_epi8('0' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), c));
+  __m256i plus = _mm256_cmpeq_epi8(c, _mm256_set1_epi8('+'));
+  __m256i slash = _mm256_cmpeq_epi8(c, _mm256_set1_epi8('/'));
+  __m256i valid = _mm256_or_si256(_mm256_or_si256(upper, lower), _mm256_or_si256(_mm256_or_si256(digit, plus), slash));
+  if(_mm256_movemask_epi8(valid) != -1) return false;
+  __m256i shift = _mm256_or_si256(_mm256_or_si256(_mm256_and_si256(upper, _mm256_set1_epi8(-'A')),
+                                                  _mm256_and_si256(lower, _mm256_set1_epi8(26 - 'a'))),
+                                  _mm256_or_si256(_mm256_or_si256(_mm256_and_si256(digit, _mm256_set1_epi8(52 - '0')),
+                                                                  _mm256_and_si256(plus, _mm256_set1_epi8(62 - '+'))),
+                                                  _mm256_and_si256(slash, _mm256_set1_epi8(63 - '/'))));
+  *values = _mm256_add_epi8(c, shift);
+  return true;
+}
+
+// Decodes blocks of 32 base64 characters to 24 bytes, as long as they contain
+// nothing but characters from the base64 alphabet. Stops at the first block
+// that contains anything else, such as whitespace or padding. Writes up to 4
+// bytes more than decoded to out. Returns the amount of characters done.
+TARGET_AVX2 inline size_t base64_decode_blocks_avx2(const char* in, size_t size, char* out) {
+  size_t i = 0;
+  const __m256i shuf2 = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                         2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+  for(; i + 32 <= size; i += 32) {
+    __m256i values;
+    if(!base64_values(_mm256_loadu_si256((const __m256i*)(in + i)), &values)) return i;
+    // merge sextet pairs to 12 bits, then those pairs to the 24 bits of a group
+    __m256i pairs = _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+    __m256i groups = _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000));
+    __m256i bytes = _mm256_shuffle_epi8(groups, shuf2);
+    char* o = out + i / 4 * 3;
+    _mm_storeu_si128((__m128i*)o, _mm256_castsi256_si128(bytes));
+    _mm_storeu_si128((__m128i*)(o + 12), _mm256_extracti128_si256(bytes, 1));
+  }
+  return i;
+}
+
+// like base64_decode_blocks_avx2, for blocks of 16 characters
+TARGET_SSE42 inline size_t base64_decode_blocks_sse(const char* in, size_t size, char* out) {
+  size_t i = 0;
+  const __m128i shuf = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+  for(; i + 16 <= size; i += 16) {
+    __m128i values;
+    if(!base64_values(_mm_loadu_si128((const __m128i*)(in + i)), &values)) return i;
+    __m128i pairs = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+    __m128i groups = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+    _mm_storeu_si128((__m128i*)(out + i / 4 * 3), _mm_shuffle_epi8(groups, shuf));
+  }
+  return i;
+}
+#endif
+
+// Encodes groups of 3 bytes to 4 base64 characters, several at a time with
+// SIMD. Groups that don't fill a block, and the last ones for which reading
+// 16 bytes would go past the end of the input, are left to the caller.
+// Returns the amount of groups done.
+inline size_t base64_encode_groups(const unsigned char* in, size_t groups, char* out) {
+  size_t g = 0;
+#if defined(BASE256_X86)
+  switch(simd_kernel()) {
+    case KERNEL_AVX512:
+    case KERNEL_AVX2:
+      g = base64_encode_groups_avx2(in, groups, out);
+      // fall through
+    case KERNEL_SSE42:
+      g += base64_encode_groups_sse(in + g * 3, groups - g, out + g * 4);
+      // fall through
+    default:
+      break;
+  }
+#endif
+  return g;
+}
+
+// Decodes blocks of base64 characters with SIMD, as long as they contain
+// nothing but characters from the base64 alphabet, see
+// base64_decode_blocks_avx2. Returns the amount of characters done.
+inline size_t base64_decode_blocks(const char* in, size_t size, char* out) {
+  size_t i = 0;
+#if defined(BASE256_X86)
+  switch(simd_kernel()) {
+    case KERNEL_AVX512:
+    case KERNEL_AVX2:
+      i = base64_decode_blocks_avx2(in, size, out);
+      // fall through
+    case KERNEL_SSE42:
+      i += base64_decode_blocks_sse(in + i, size - i, out + i / 4 * 3);
+      // fall through
+    default:
+      break;
+  }
+#endif
+  return i;
+}
+
+class Base64 : public Format {
+ public:
+  Base64() {
+    for(int i = 0; i < 256; i++) values[i] = INVALID;
+    for(int i = 0; i < 64; i++) values[(unsigned char)BASE64[i]] = i;
+    values[(unsigned char)' '] = values[(unsigned char)'\t'] = values[(unsigned char)'\n'] = SKIP;
+    values[(unsigned char)'\r'] = values[(unsigned char)'\v'] = values[(unsigned char)'\f'] = SKIP;
+    values[(unsigned char)'='] = PAD;
+  }
+
+  // the state has the amount of bytes in num and the bits of the current
+  // group of 3 bytes in v
+  std::string encodeChar(unsigned char c, unsigned char prev, unsigned char next, FormatState* state) {
+    int r = state->num % 3;
+    state->num++;
+    size_t& v = state->v;
+    if(r == 0) v = (c << 16u);
+    else if(r == 1) v |= (c << 8u);
+    else v |= c;
+    std::string result;
+    if(r == 0) {
+      result += BASE64[(v >> 18) & 0x3f];
+    } else if(r == 1) {
+      result += BASE64[(v >> 12) & 0x3f];
+    } else {
+      result += BASE64[(v >>  6) & 0x3f];
+      result += BASE64[(v >>  0) & 0x3f];
+    }
+    return result;
+  }
+
+  virtual bool blockencode() const { return true; }
+
+  virtual size_t groupsize() const { return 3; }
+
+  virtual void encodeBlock(const unsigned char* in, size_t size, FormatState* state, std::string* out) {
+    size_t i = 0;
+    // finish the group of 3 bytes that earlier calls started
+    while(i < size && state->num % 3 != 0) *out += encodeChar(in[i++], 0, 0, state);
+    size_t groups = (size - i) / 3;
+    size_t pos = out->size();
+    out->resize(pos + groups * 4);
+    char* o = &(*out)[pos];
+    for(size_t g = base64_encode_groups(in + i, groups, o); g < groups; g++) {
+      const unsigned char* p = in + i + g * 3;
+      size_t w = (p[0] << 16u) | (p[1] << 8u) | p[2];
+      o[g * 4 + 0] = BASE64[(w >> 18) & 0x3f];
+      o[g * 4 + 1] = BASE64[(w >> 12) & 0x3f];
+      o[g * 4 + 2] = BASE64[(w >>  6) & 0x3f];
+      o[g * 4 + 3] = BASE64[(w >>  0) & 0x3f];
+    }
+    i += groups * 3;
+    state->num += groups * 3;
+    while(i < size) *out += encodeChar(in[i++], 0, 0, state);
+  }
+
+  virtual std::string close(const FormatState& state) {
+    int r = state.num % 3;
+    size_t v = state.v;
+    std::string result;
+    if(r == 0) {
+    }
+    if(r == 1) {
+      result += BASE64[(v >> 12) & 0x3f];
+      result += "==";
+    }
+    if(r == 2) {
+      result += BASE64[(v >> 6) & 0x3f];
+      result += "=";
+    }
+    return result;
+  }
+
+  // Whitespace and the commas of --comma are skipped, as are other invalid
+  // characters after reporting them. The state has the values of the
+  // unfinished group in v, their amount in count and the amount of characters
+  // seen in num.
+  virtual void decodeFeed(const char* s, size_t size, FormatState* state, std::string* out) {
+    size_t pos = out->size();
+    // 2 bytes for a group that the padding ends, and room for the SIMD stores
+    out->resize(pos + size / 4 * 3 + 2 + 16);
+    char* begin = &(*out)[pos];
+    char* o = begin;
+    size_t i = 0;
+    while(i < size) {
+      if(state->count == 0) {
+        size_t done = base64_decode_blocks(s + i, size - i, o);
+        i += done;
+        o += done / 4 * 3;
+        if(i == size) break;
+      }
+      int d = values[(unsigned char)s[i]];
+      if(d >= 0) {
+        state->v = (state->v << 6) | d;
+        if(++state->count == 4) {
+          *o++ = state->v >> 16;
+          *o++ = state->v >> 8;
+          *o++ = state->v;
+          state->v = 0;
+          state->count = 0;
+        }
+      } else if(d == PAD) {
+        o += flush(state, o);
+      } else if(d == INVALID && !(s[i] == ',' && state->separator)) {
+        report(state, "invalid base64 character: " + std::to_string((unsigned char)s[i]) + " at " + std::to_string(state->num + i));
+      }
+      i++;
+    }
+    state->num += size;
+    out->resize(pos + (o - begin));
+  }
+
+  // outputs the last bytes if they were not padded
+  virtual size_t decodeSplit(const char* s, size_t size, size_t pos) const {
+    return split_after_space(s, size, pos);
+  }
+
+  virtual void decodeFinish(FormatState* state, std::string* out) {
+    char last[2];
+    out->append(last, flush(state, last));
+  }
+
+  virtual int width() const {
+    return 1;
+  }
+
+  const char* BASE64 = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+ private:
+  // ends the unfinished group, as is done by padding, returns amount of bytes
+  int flush(FormatState* state, char* out) {
+    int result = 0;
+    if(state->count == 2) {
+      out[result++] = state->v >> 4;
+    } else if(state->count == 3) {
+      out[result++] = state->v >> 10;
+      out[result++] = state->v >> 2;
+    }
+    state->v = 0;
+    state->count = 0;
+    return result;
+  }
+
+  static const int INVALID = -1;
+  static const int SKIP = -2;
+  static const int PAD = -3;
+  int values[256]; // value of each character, or one of the above
+};
+
+// The layout of hex text that hex_decode_units decodes, taken from its first
+// value: every value is a unit of size characters, with the high and the low
+// digit at hi and hi + 1 and the same other characters (a prefix and
+// separator) as the first one. The tables are for a block of 16 characters,
+// which has count whole units.
+struct HexUnits {
+  size_t size = 0; // 0 if not set yet
+  size_t hi = 0;
+  size_t count = 0;
+  char text[16]; // the characters other than the digits
+  char digit[16]; // -1 where a digit is, else 0
+  char ignore[16]; // -1 after the last whole unit, else 0
+  char high[16]; // shuffle indices of the high digits of the units
+  char low[16]; // shuffle indices of the low digits of the units
+
+  void init(const char* unit, size_t size, size_t hi) {
+    this->size = size;
+    this->hi = hi;
+    count = 16 / size;
+    for(size_t p = 0; p < 16; p++) {
+      size_t r = p % size;
+      bool inblock = p < count * size;
+      bool isdigit = inblock && (r == hi || r == hi + 1);
+      text[p] = inblock && !isdigit ? unit[r] : 0;
+      digit[p] = isdigit ? -1 : 0;
+      ignore[p] = inblock ? 0 : -1;
+      high[p] = p < count ? p * size + hi : -1;
+      low[p] = p < count ? p * size + hi + 1 : -1;
+    }
+  }
+
+  // whether the unit of size characters at s has this layout
+  bool same(const char* s, size_t size) const {
+    if(size != this->size) return false;
+    for(size_t p = 0; p < size; p++) {
+      if(!digit[p] && s[p] != text[p]) return false;
+    }
+    return true;
+  }
+};
+
+#if defined(BASE256_X86)
+// Converts 16 characters of hex text with the layout of the tables to the
+// values of their digits, returns false if a digit is not a hex digit or
+// another character differs from text. Digits may be in either case.
+TARGET_SSE42 static inline bool hex_values(__m128i c, __m128i text, __m128i digit, __m128i ignore, __m128i* values) {
+  __m128i d = _mm_sub_epi8(c, _mm_set1_epi8('0'));
+  __m128i dec = _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(9)), d);
+  __m128i l = _mm_sub_epi8(_mm_or_si128(c, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+  __m128i alpha = _mm_cmpeq_epi8(_mm_min_epu8(l, _mm_set1_epi8(5)), l);
+  __m128i good = _mm_blendv_epi8(_mm_cmpeq_epi8(c, text), _mm_or_si128(dec, alpha), digit);
+  if(_mm_movemask_epi8(_mm_or_si128(good, ignore)) != 0xffff) return false;
+  *values = _mm_blendv_epi8(_mm_add_epi8(l, _mm_set1_epi8(10)), d, dec);
+  return true;
+}
+
+TARGET_AVX2 static inline bool hex_values(__m256i c, __m256i text, __m256i digit, __m256i ignore, __m256i* values) {
+  __m256i d = _mm256_sub_epi8(c, _mm256_set1_epi8('0'));
+  __m256i dec = _mm256_cmpeq_epi8(_mm256_min_epu8(d, _mm256_set1_epi8(9)), d);
+  __m256i l = _mm256_sub_epi8(_mm256_or_si256(c, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+  __m256i alpha = _mm256_cmpeq_epi8(_mm256_min_epu8(l, _mm256_set1_epi8(5)), l);
+  __m256i good = _mm256_blendv_epi8(_mm256_cmpeq_epi8(c, text), _mm256_or_si256(dec, alpha), digit);
+  if(_mm256_movemask_epi8(_mm256_or_si256(good, ignore)) != -1) return false;
+  *values = _mm256_blendv_epi8(_mm256_add_epi8(l, _mm256_set1_epi8(10)), d, dec);
+  return true;
+}
+
+TARGET_AVX512 static inline bool hex_values(__m512i c, __m512i text, __mmask64 digit, __mmask64 ignore, __m512i* values) {
+  __m512i d = _mm512_sub_epi8(c, _mm512_set1_epi8('0'));
+  __mmask64 dec = _mm512_cmple_epu8_mask(d, _mm512_set1_epi8(9));
+  __m512i l = _mm512_sub_epi8(_mm512_or_si512(c, _mm512_set1_epi8(0x20)), _mm512_set1_epi8('a'));
+  __mmask64 alpha = _mm512_cmple_epu8_mask(l, _mm512_set1_epi8(5));
+  __mmask64 good = ((dec | alpha) & digit) | (_mm512_cmpeq_epi8_mask(c, text) & ~digit);
+  if((good | ignore) != ~(__mmask64)0) return false;
+  *values = _mm512_mask_blend_epi8(dec, _mm512_add_epi8(l, _mm512_set1_epi8(10)), d);
+  return true;
+}
+
+// Decodes hex text with the layout of units, 4 blocks (see HexUnits) at a
+// time, one in each 128-bit lane: 64 digits per iteration without
+// separators, 40 with the spaces between values. Stops at the first blocks
+// that have anything else, such as a newline. Writes up to 16 bytes more than
+// decoded to out. Returns the amount of characters done.
+TARGET_AVX512 inline size_t hex_decode_units_avx512(const char* in, size_t size, const HexUnits& units, char* out) {
+  size_t i = 0;
+  size_t block = units.count * units.size;
+  const __m512i text = broadcast_lanes(_mm_loadu_si128((const __m128i*)units.text));
+  const __mmask64 digit = _mm512_movepi8_mask(broadcast_lanes(_mm_loadu_si128((const __m128i*)units.digit)));
+  const __mmask64 ignore = _mm512_movepi8_mask(broadcast_lanes(_mm_loadu_si128((const __m128i*)units.ignore)));
+  const __m512i high = broadcast_lanes(_mm_loadu_si128((const __m128i*)units.high));
+  const __m512i low = broadcast_lanes(_mm_loadu_si128((const __m128i*)units.low));
+  for(; i + 3 * block + 16 <= size; i += 4 * block) {
+    __m512i c = _mm512_castsi128_si512(_mm_loadu_si128((const __m128i*)(in + i)));
+    c = _mm512_inserti32x4(c, _mm_loadu_si128((const __m128i*)(in + i + block)), 1);
+    c = _mm512_inserti32x4(c, _mm_loadu_si128((const __m128i*)(in + i + 2 * block)), 2);
+    c = _mm512_inserti32x4(c, _mm_loadu_si128((const __m128i*)(in + i + 3 * block)), 3);
+    __m512i values;
+    if(!hex_values(c, text, digit, ignore, &values)) break;
+    __m512i bytes = _mm512_or_si512(_mm512_slli_epi16(_mm512_shuffle_epi8(values, high), 4), _mm512_shuffle_epi8(values, low));
+    char* o = out + i / units.size;
+    _mm_storeu_si128((__m128i*)o, extract_lane<0>(bytes));
+    _mm_storeu_si128((__m128i*)(o + units.count), extract_lane<1>(bytes));
+    _mm_storeu_si128((__m128i*)(o + 2 * units.count), extract_lane<2>(bytes));
+    _mm_storeu_si128((__m128i*)(o + 3 * units.count), extract_lane<3>(bytes));
+  }
+  return i;
+}
+
+// like hex_decode_units_avx512, 2 blocks at a time
+TARGET_AVX2 inline size_t hex_decode_units_avx2(const char* in, size_t size, const HexUnits& units, char* out) {
+  size_t i = 0;
+  size_t block = units.count * units.size;
+  const __m256i text = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)units.text));
+  const __m256i digit = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)units.digit));
+  const __m256i ignore = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)units.ignore));
+  const __m256i high = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)units.high));
+  const __m256i low = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)units.low));
+  for(; i + block + 16 <= size; i += 2 * block) {
+    __m256i c = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(in + i))),
+                                        _mm_loadu_si128((const __m128i*)(in + i + block)), 1);
+    __m256i values;
+    if(!hex_values(c, text, digit, ignore, &values)) break;
+    __m256i bytes = _mm256_or_si256(_mm256_slli_epi16(_mm256_shuffle_epi8(values, high), 4), _mm256_shuffle_epi8(values, low));
+    char* o = out + i / units.size;
+    _mm_storeu_si128((__m128i*)o, _mm256_castsi256_si128(bytes));
+    _mm_storeu_si128((__m128i*)(o + units.count), _mm256_extracti128_si256(bytes, 1));
+  }
+  return i;
+}
+
+// like hex_decode_units_avx512, 1 block at a time
+TARGET_SSE42 inline size_t hex_decode_units_sse(const char* in, size_t size, const HexUnits& units, char* out) {
+  size_t i = 0;
+  size_t block = units.count * units.size;
+  const __m128i text = _mm_loadu_si128((const __m128i*)units.text);
+  const __m128i digit = _mm_loadu_si128((const __m128i*)units.digit);
+  const __m128i ignore = _mm_loadu_si128((const __m128i*)units.ignore);
+  const __m128i high = _mm_loadu_si128((const __m128i*)units.high);
+  const __m128i low = _mm_loadu_si128((const __m128i*)units.low);
+  for(; i + 16 <= size; i += block) {
+    __m128i values;
+    if(!hex_values(_mm_loadu_si128((const __m128i*)(in + i)), text, digit, ignore, &values)) break;
+    __m128i bytes = _mm_or_si128(_mm_slli_epi16(_mm_shuffle_epi8(values, high), 4), _mm_shuffle_epi8(values, low));
+    _mm_storeu_si128((__m128i*)(out + i / units.size), bytes);
+  }
+  return i;
+}
+#endif
+
+// Decodes hex text with the layout of units with SIMD, as far as it has that
+// layout, see hex_decode_units_avx512. The last characters, for which reading
+// 16 would go past the end, are left to the caller. Returns the amount of
+// characters done, a multiple of units.size.
+inline size_t hex_decode_units(const char* in, size_t size, const HexUnits& units, char* out) {
+  size_t i = 0;
+#if defined(BASE256_X86)
+  switch(simd_kernel()) {
+    case KERNEL_AVX512:
+      i = hex_decode_units_avx512(in, size, units, out);
+      // fall through
+    case KERNEL_AVX2:
+      i += hex_decode_units_avx2(in + i, size - i, units, out + i / units.size);
+      // fall through
+    case KERNEL_SSE42:
+      i += hex_decode_units_sse(in + i, size - i, units, out + i / units.size);
+      // fall through
+    default:
+      break;
+  }
+#endif
+  return i;
+}
+
+class Hex : public Format {
+ public:
+  Hex(bool prefix = false, bool lower = false) : prefix(prefix),
+      digits(lower ? digits_lower : digits_upper)  {
+    for(int i = 0; i < 256; i++) values[i] = INVALID;
+    for(int i = 0; i < 10; i++) values['0' + i] = i;
+    for(int i = 0; i < 6; i++) values['a' + i] = values['A' + i] = 10 + i;
+    values[(unsigned char)' '] = values[(unsigned char)'\t'] = values[(unsigned char)'\n'] = SKIP;
+    values[(unsigned char)'\r'] = values[(unsigned char)'\v'] = values[(unsigned char)'\f'] = SKIP;
+  }
+
+  virtual bool contextfree() const { return true; }
+
+  virtual BytePattern bytepattern() const {
+    BytePattern result;
+    result.kind = BytePattern::NIBBLES;
+    result.pattern = prefix ? "0x\1\2" : "\1\2";
+    result.digits = digits;
+    return result;
+  }
+
+  std::string encodeChar(unsigned char c, unsigned char prev, unsigned char next, FormatState* state) {
+    std::string result;
+    result += digits[(c >> 4) & 15];
+    result += digits[c & 15];
+    if(prefix) result = "0x" + result;
+    return result;
+  }
+
+  // The state has the value and amount of digits in v and count, and in mode
+  // whether a "0x" prefix may be starting (1 for "0", 2 for "0x"). A prefix
+  // is only skipped if something follows it, and the character after it is
+  // never the start of another prefix. Whitespace and the commas of --comma
+  // are skipped, as are other invalid characters after reporting them. Runs
+  // of values that are laid out alike, as encoded, are decoded with SIMD.
+  virtual void decodeFeed(const char* s, size_t size, FormatState* state, std::string* out) {
+    size_t pos = out->size();
+    // room for the SIMD stores
+    out->resize(pos + size / 2 + 1 + 16);
+    char* begin = &(*out)[pos];
+    char* o = begin;
+    HexUnits units;
+    bool simd = simd_kernel() != KERNEL_SCALAR;
+    for(size_t i = 0; i < size; i++) {
+      if(simd && state->count % 2 == 0 && state->mode == 0) {
+        size_t unit = unitSize(s + i, size - i, *state);
+        if(unit != 0) {
+          if(!units.same(s + i, unit)) units.init(s + i, unit, prefix ? 2 : 0);
+          size_t done = hex_decode_units(s + i, size - i, units, o);
+          i += done;
+          o += done / unit;
+          if(i == size) break;
+        }
+      }
+      char c = s[i];
+      if(prefix && state->mode == 1) {
+        state->mode = 0;
+        if(c == 'x') {
+          state->mode = 2;
+          continue;
+        }
+        o += digit(0, state->num + i - 1, state, o);
+      }
+      if(prefix && state->mode == 2) {
+        state->mode = 0;
+      } else if(prefix && c == '0') {
+        state->mode = 1;
+        continue;
+      }
+      int d = values[(unsigned char)c];
+      if(d >= 0) {
+        o += digit(d, state->num + i, state, o);
+      } else if(d == INVALID && !(c == ',' && state->separator)) {
+        report(state, "invalid hex character: " + std::to_string((unsigned char)c) + " at " + std::to_string(state->num + i));
+      }
+    }
+    state->num += size;
+    out->resize(pos + (o - begin));
+  }
+
+  virtual void decodeFinish(FormatState* state, std::string* out) {
+    // an unfinished prefix at the end was a digit after all
+    char last = 0;
+    if(state->mode != 0) out->append(&last, digit(0, state->num - state->mode, state, &last));
+    state->mode = 0;
+    if(state->count % 2) report(state, "hex digit without a second digit at " + std::to_string(state->start));
+  }
+
+  virtual size_t decodeSplit(const char* s, size_t size, size_t pos) const {
+    return split_after_space(s, size, pos);
+  }
+
+  virtual bool decodeClean(const FormatState& state) const {
+    return state.count % 2 == 0 && state.mode == 0;
+  }
+
+  virtual int width() const {
+    return prefix ? 4 : 2;
+  }
+
+  virtual bool space() const {
+    return true;
+  }
+
+  const char* digits_lower = "0123456789abcdef";
+  const char* digits_upper = "0123456789ABCDEF";
+  const char* digits;
+
+  bool prefix;
+
+ private:
+  // adds the digit d at position pos of the input to the state, returns the
+  // amount of bytes, 0 or 1, that this finishes to out
+  int digit(int d, size_t pos, FormatState* state, char* out) {
+    state->count++;
+    if(state->count % 2 == 0) {
+      *out = (state->v << 4) | d;
+      return 1;
+    }
+    state->v = d;
+    state->start = pos;
+    return 0;
+  }
+
+  // the size of the value at s, with its prefix and the separator after it,
+  // if it's laid out the way hex_decode_units can decode it: two digits,
+  // with the prefix if used, followed by up to two spaces or commas of
+  // --comma. 0 if not.
+  size_t unitSize(const char* s, size_t size, const FormatState& state) const {
+    size_t hi = prefix ? 2 : 0;
+    if(size < hi + 2) return 0;
+    if(prefix && (s[0] != '0' || s[1] != 'x')) return 0;
+    if(values[(unsigned char)s[hi]] < 0 || values[(unsigned char)s[hi + 1]] < 0) return 0;
+    size_t result = hi + 2;
+    while(result < hi + 4 && result < size && (s[result] == ' ' || (s[result] == ',' && state.separator))) result++;
+    return result;
+  }
+
+  static const int INVALID = -1;
+  static const int SKIP = -2;
+  int values[256]; // value of each character, or one of the above
+};
+
+class Decimal : public Format {
+ public:
+  Decimal(bool prefix = false) : prefix(prefix) {
+  }
+
+  virtual bool contextfree() const { return true; }
+
+  std::string encodeChar(unsigned char c, unsigned char prev, unsigned char next, FormatState* state) {
+    static const std::string d = "0123456789";
+    std::string result;
+    if(prefix) {
+      if(c >= 100) result += d[c / 100];
+      if(c >= 10) result += d[(c / 10) % 10];
+      result += d[c % 10];
+    } else {
+      result += d[c / 100];
+      result += d[(c / 10) % 10];
+      result += d[c % 10];
+    }
+    return result;
+  }
+
+  // The state has the value and amount of digits in v and count. With the
+  // prefix, numbers have no leading zeros and end at anything else.
+  virtual void decodeFeed(const char* s, size_t size, FormatState* state, std::string* out) {
+    for(size_t i = 0; i < size; i++) {
+      char c = s[i];
+      if(prefix) {
+        if(c >= '0' && c <= '9') {
+          state->v = state->v * 10 + (c - '0');
+          state->count++;
+        } else if(state->count) {
+          out->push_back(state->v);
+          state->v = 0;
+          state->count = 0;
+        }
+        continue;
+      }
+      if((c >= '0' && c <= '9')) {
+        int d = c - '0';
+        if(state->count % 3 == 0) {
+          state->v = d;
+        } else {
+          state->v *= 10;
+          state->v += d;
+        }
+        if(state->count % 3 == 2) out->push_back(state->v);
+        state->count++;
+      }
+    }
+  }
+
+  virtual size_t decodeSplit(const char* s, size_t size, size_t pos) const {
+    return split_after_space(s, size, pos);
+  }
+
+  virtual void decodeFinish(FormatState* state, std::string* out) {
+    if(prefix && state->count) out->push_back(state->v);
+    state->v = 0;
+    state->count = 0;
+  }
+
+  virtual bool decodeClean(const FormatState& state) const {
+    return prefix ? state.count == 0 : state.count % 3 == 0;
+  }
+
+  virtual int width() const {
+    return 3;
+  }
+
+  virtual bool space() const {
+    return true;
+  }
+
+  bool prefix;
+};
+
+class Octal : public Format {
+ public:
+  Octal(bool prefix = false) : prefix(prefix) {
+  }
+
+  virtual bool contextfree() const { return true; }
+
+  std::string encodeChar(unsigned char c, unsigned char prev, unsigned char next, FormatState* state) {
+    static const std::string d = "01234567";
+    std::string result;
+    result += d[c / 64];
+    result += d[(c / 8) % 8];
+    result += d[c % 8];
+    if(prefix) result = "0" + result;
+    return result;
+  }
+
+  virtual int width() const {
+    return prefix ? 4 : 3;
+  }
+
+  virtual bool space() const {
+    return true;
+  }
+
+  bool prefix;
+};
+
+class Binary : public Format {
+ public:
+  Binary(bool lsb_first, bool prefix = false) : lsb_first(lsb_first), prefix(prefix) {
+  }
+
+  virtual bool contextfree() const { return true; }
+
+  std::string encodeChar(unsigned char c, unsigned char prev, unsigned char next, FormatState* state) {
+    std::string result;
+    for(int j = 0; j < 8; j++) {
+      if(lsb_first) {
+        result += ((c >> j) & 1) ? '1' : '0';
+      } else {
+        result += ((c >> (7 - j)) & 1) ? '1' : '0';
+      }
+    }
+    if(prefix) result = "0b" + result;
+    return result;
+  }
+
+  virtual int width() const {
+    return prefix ? 10 : 8;
+  }
+
+  virtual bool space() const {
+    return true;
+  }
+
+
+
+  // the state has the value and amount of bits in v and count
+  virtual void decodeFeed(const char* s, size_t size, FormatState* state, std::string* out) {
+    for(size_t i = 0; i < size; i++) {
+      char c = s[i];
+      // the 0 of a "0b" prefix was taken as the first bit
+      if(prefix && c == 'b' && state->count == 1 && state->v == 0) state->count = 0;
+      if(c != '0' && c != '1') continue;
+      if(lsb_first) {
+        state->v |= (c == '1' ? 1 : 0) << state->count;
+      } else {
+        state->v <<= 1;
+        state->v |= (c == '1' ? 1 : 0);
+      }
+      state->count++;
+      if(state->count == 8) {
+        state->count = 0;
+        char c2 = state->v;
+        *out += c2;
+        state->v = 0;
+      }
+    }
+  }
+
+  virtual size_t decodeSplit(const char* s, size_t size, size_t pos) const {
+    return split_after_space(s, size, pos);
+  }
+
+  virtual void decodeFinish(FormatState* state, std::string* out) {
+    if(state->count != 0) {
+      char c2 = state->v;
+      *out += c2;
+    }
+    state->count = 0;
+    state->v = 0;
+  }
+
+  bool prefix;
+  bool lsb_first;
+};
+
+
+
+class Colored : public Format {
+ public:
+  Colored() {
+  }
+
+  virtual bool contextfree() const { return true; }
+
+  std::string encodeChar(unsigned char c, unsigned char prev, unsigned char next, FormatState* state) {
+    return " ";
+  }
+
+  virtual std::string colorcode(unsigned char c) const {
+    return std::string() + "\x1b" + "[48;5;" + valtostr((int)c) + "m";
+  }
+};
+
+// strict ANSI-C compatible string
+class CString : public Format {
+ public:
+  CString() {}
+
+  virtual bool printable() const { return true; }
+
+  std::string encodeChar(unsigned char c, unsigned char prev, unsigned char next, FormatState* state) {
+    state->num++;
+    if(c == '\a') return "\\a";
+    if(c == '\b') return "\\b";
+    if(c == '\f') return "\\f";
+    if(c == '\n') return "\\n";
+    if(c == '\r') return "\\r";
+    if(c == '\t') return "\\t";
+    if(c == '\v') return "\\v";
+    if(c == '\\') return "\\\\";
+    if(c == '"') return "\\\"";
+    if(c == '?' && prev == '?') return "\\?"; // prevent trigraphs
+    if(c >= 32 && c < 127) {
+      std::string result;
+      result += c;
+      return result;
+    }
+    // octal
+    // octal is used, not hexadecimal ("\x..."), because octal is defined to end after 3 characters, while
+    // hexadecimal can keep going on indefinitely (it doesn't end after 2) as long as valid hex digits follow,
+    // so hexadecimal is harder to deal with if an actual 0-7 or a-f character would follow (requires ending and reopening the string literal)
+    bool digitnext = (next >= '0' && next <= '7');
+    int o0 = (c >> 6) & 7;
+    int o1 = (c >> 3) & 7;
+    int o2 = (c >> 0) & 7;
+    std::string result = "\\";
+    // shorten if possible, e.g. many nulls in a row will be \0\0\0\0 instead of \000\\000\000\000
+    // using \0 and other less than 3 digit codes is only ok if no real octal digit after it, else the next character becomes part of the code
+    if(c < 8 && !digitnext) {
+      result += ('0' + o2);
+    } else if (c < 64 && !digitnext) {
+      result += ('0' + o1);
+      result += ('0' + o2);
+    } else {
+      result += ('0' + o0);
+      result += ('0' + o1);
+      result += ('0' + o2);
+    }
+    return result;
+  }
+
+  virtual void decodeFeed(const char* s, size_t size, FormatState* state, std::string* out) {
+    decode_string_literal(s, size, '"', state, out);
+  }
+
+  virtual void decodeFinish(FormatState* state, std::string* out) {
+    decode_string_literal_finish(state, out);
+  }
+
+  virtual std::string open() {
+    return "\"";
+  }
+
+  virtual std::string close(const FormatState& state) {
+    return "\" /*size:" + valtostr(state.num) + "+1*/";
+  }
+
+  virtual std::string linebeg() {
+    return "\"";
+  }
+
+  virtual std::string lineend() {
+    return "\"";
+  }
+
+  virtual bool outwidth() {
+    return true;
+  }
+};
+
+// C++ string with size given to the constructor as well so that it can contain null characters
+class CPPString : public Format {
+ public:
+  CPPString() {}
+
+  virtual bool printable() const { return true; }
+
+  std::string encodeChar(unsigned char c, unsigned char prev, unsigned char next, FormatState* state) {
+    state->num++;
+    if(c == '\a') return "\\a";
+    if(c == '\b') return "\\b";
+    if(c == '\f') return "\\f";
+    if(c == '\n') return "\\n";
+    if(c == '\r') return "\\r";
+    if(c == '\t') return "\\t";
+    if(c == '\v') return "\\v";
+    if(c == '\\') return "\\\\";
+    if(c == '"') return "\\\"";
+    if(c == '?' && prev == '?') return "\\?"; // prevent trigraphs
+    if(c >= 32 && c < 127) {
+      std::string result;
+      result += c;
+      return result;
+    }
+    // octal
+    // octal is used, not hexadecimal ("\x..."), because octal is defined to end after 3 characters, while
+    // hexadecimal can keep going on indefinitely (it doesn't end after 2) as long as valid hex digits follow,
+    // so hexadecimal is harder to deal with if an actual 0-7 or a-f character would follow (requires ending and reopening the string literal)
+    bool digitnext = (next >= '0' && next <= '7');
+    int o0 = (c >> 6) & 7;
+    int o1 = (c >> 3) & 7;
+    int o2 = (c >> 0) & 7;
+    std::string result = "\\";
+    // shorten if possible, e.g. many nulls in a row will be \0\0\0\0 instead of \000\\000\000\000
+    // using \0 and other less than 3 digit codes is only ok if no real octal digit after it, else the next character becomes part of the code
+    if(c < 8 && !digitnext) {
+      result += ('0' + o2);
+    } else if (c < 64 && !digitnext) {
+      result += ('0' + o1);
+      result += ('0' + o2);
+    } else {
+      result += ('0' + o0);
+      result += ('0' + o1);
+      result += ('0' + o2);
+    }
+    return result;
+  }
+
+  virtual void decodeFeed(const char* s, size_t size, FormatState* state, std::string* out) {
+    decode_string_literal(s, size, '"', state, out);
+  }
+
+  virtual void decodeFinish(FormatState* state, std::string* out) {
+    decode_string_literal_finish(state, out);
+  }
+
+  virtual std::string open() {
+    return "std::string(\"";
+  }
+
+  virtual std::string close(const FormatState& state) {
+    return "\", " + valtostr(state.num) + ")";
+  }
+
+  virtual std::string linebeg() {
+    return "\"";
+  }
+
+  virtual std::string lineend() {
+    return "\"";
+  }
+
+  virtual bool outwidth() {
+    return true;
+  }
+};
+
+// Java-compatible string, per byte, it does *not* group 2 bytes for UTF-16.
+class JavaString : public Format {
+ public:
+  JavaString() {}
+
+  virtual bool printable() const { return true; }
+
+  std::string encodeChar(unsigned char c, unsigned char prev, unsigned char next, FormatState* state) {
+    if(c == '\b') return "\\b";
+    if(c == '\f') return "\\f";
+    if(c == '\n') return "\\n";
+    if(c == '\r') return "\\r";
+    if(c == '\t') return "\\t";
+    if(c == '\\') return "\\\\";
+    if(c == '"') return "\\\"";
+    if(c >= 32 && c < 127) {
+      std::string result;
+      result += c;
+      return result;
+    }
+    // octal: we work byte-based, so don't use \u unicode escapes, which are longer
+    bool digitnext = (next >= '0' && next <= '7');
+    int o0 = (c >> 6) & 7;
+    int o1 = (c >> 3) & 7;
+    int o2 = (c >> 0) & 7;
+    std::string result = "\\";
+    // shorten if possible, e.g. many nulls in a row will be \0\0\0\0 instead of \000\\000\000\000
+    // using \0 and other less than 3 digit codes is only ok if no real octal digit after it, else the next character becomes part of the code
+    if(c < 8 && !digitnext) {
+      result += ('0' + o2);
+    } else if (c < 64 && !digitnext) {
+      result += ('0' + o1);
+      result += ('0' + o2);
+    } else {
+      result += ('0' + o0);
+      result += ('0' + o1);
+      result += ('0' + o2);
+    }
+    return result;
+  }
+
+  virtual void decodeFeed(const char* s, size_t size, FormatState* state, std::string* out) {
+    decode_string_literal(s, size, '"', state, out);
+  }
+
+  virtual void decodeFinish(FormatState* state, std::string* out) {
+    decode_string_literal_finish(state, out);
+  }
+
+  virtual std::string open() {
+    return "\"";
+  }
+
+  virtual std::string close(const FormatState& state) {
+    return "\"";
+  }
+
+  virtual std::string linebeg() {
+    return "\"";
+  }
+
+  virtual std::string lineend() {
+    return "\" +";
+  }
+
+  virtual bool outwidth() {
+    return true;
+  }
+};
+
+// JS-compatible string, per byte, it does *not* group 2 bytes for UTF-16.
+class JSString : public Format {
+ public:
+  JSString() {}
+
+  virtual bool printable() const { return true; }
+
+  std::string encodeChar(unsigned char c, unsigned char prev, unsigned char next, FormatState* state) {
+    if(c == '\b') return "\\b";
+    if(c == '\f') return "\\f";
+    if(c == '\n') return "\\n";
+    if(c == '\r') return "\\r";
+    if(c == '\t') return "\\t";
+    if(c == '\\') return "\\\\";
+    if(c == '\'') return "\\'";
+    if(c >= 32 && c < 127) {
+      std::string result;
+      result += c;
+      return result;
+    }
+    // in JS \0 is different than other octal, and should not have any *decimal* digit after it
+    bool digitnext = (next >= '0' && next <= '9');
+    if(c == 0 && !digitnext) return "\\0";
+    int h0 = (c >> 4) & 15;
+    int h1 = (c >> 0) & 15;
+    static const std::string hex = "0123456789ABCDEF";
+    std::string result = "\\x";
+    result += hex[h0];
+    result += hex[h1];
+    return result;
+  }
+
+  virtual void decodeFeed(const char* s, size_t size, FormatState* state, std::string* out) {
+    decode_string_literal(s, size, '\'', state, out);
+  }
+
+  virtual void decodeFinish(FormatState* state, std::string* out) {
+    decode_string_literal_finish(state, out);
+  }
+
+  virtual std::string open() {
+    return "'";
+  }
+
+  virtual std::string close(const FormatState& state) {
+    return "'";
+  }
+
+  virtual std::string linebeg() {
+    return "'";
+  }
+
+  virtual std::string lineend() {
+    return "' +";
+  }
+
+  virtual bool outwidth() {
+    return true;
+  }
+};
+
+
+class PythonString : public Format {
+ public:
+  PythonString() {}
+
+  virtual bool printable() const { return true; }
+
+  std::string encodeChar(unsigned char c, unsigned char prev, unsigned char next, FormatState* state) {
+    if(c == '\b') return "\\b";
+    if(c == '\f') return "\\f";
+    if(c == '\n') return "\\n";
+    if(c == '\r') return "\\r";
+    if(c == '\t') return "\\t";
+    if(c == '\\') return "\\\\";
+    if(c == '\'') return "\\'";
+    if(c >= 32 && c < 127) {
+      std::string result;
+      result += c;
+      return result;
+    }
+    // octal \0 should not have any *decimal* digit after it
+    bool digitnext = (next >= '0' && next <= '9');
+    if(c == 0 && !digitnext) return "\\0";
+    int h0 = (c >> 4) & 15;
+    int h1 = (c >> 0) & 15;
+    static const std::string hex = "0123456789ABCDEF";
+    std::string result = "\\x";
+    result += hex[h0];
+    result += hex[h1];
+    return result;
+  }
+
+  virtual void decodeFeed(const char* s, size_t size, FormatState* state, std::string* out) {
+    decode_string_literal(s, size, '\'', state, out);
+  }
+
+  virtual void decodeFinish(FormatState* state, std::string* out) {
+    decode_string_literal_finish(state, out);
+  }
+
+  virtual std::string open() {
+    return "'";
+  }
+
+  virtual std::string close(const FormatState& state) {
+    return "'";
+  }
+
+  virtual std::string linebeg() {
+    return "";
+  }
+
+  virtual std::string lineend() {
+    return "\\";
+  }
+
+  virtual bool outwidth() {
+    return true;
+  }
+};
+
+// Different than JS string: using double quotes, and can only escape with \u, no \x or octal
+class JSONString : public Format {
+ public:
+  JSONString() {}
+
+  virtual bool printable() const { return true; }
+
+  std::string encodeChar(unsigned char c, unsigned char prev, unsigned char next, FormatState* state) {
+    if(c == '\b') return "\\b";
+    if(c == '\f') return "\\f";
+    if(c == '\n') return "\\n";
+    if(c == '\r') return "\\r";
+    if(c == '\t') return "\\t";
+    if(c == '\\') return "\\\\";
+    if(c == '\"') return "\\\"";
+    if(c >= 32 && c < 127) {
+      std::string result;
+      result += c;
+      return result;
+    }
+    static const std::string hex = "0123456789ABCDEF";
+    int h0 = (c >> 4) & 15;
+    int h1 = (c >> 0) & 15;
+    std::string result = "\\u00";
+    result += hex[h0];
+    result += hex[h1];
+    return result;
+  }
+
+  virtual void decodeFeed(const char* s, size_t size, FormatState* state, std::string* out) {
+    decode_string_literal(s, size, '"', state, out);
+  }
+
+  virtual void decodeFinish(FormatState* state, std::string* out) {
+    decode_string_literal_finish(state, out);
+  }
+
+  virtual std::string open() {
+    return "\"";
+  }
+
+  virtual std::string close(const FormatState& state) {
+    return "\"";
+  }
+
+  // Cannot break up string into multiple lines in JSON
+  virtual bool allowlinebreaks() {
+    return false;
+  }
+
+  virtual bool outwidth() {
+    return true;
+  }
+};
+////////////////////////////////////////////////////////////////////////////////
+
+// Makes all formats, by name, with the settings of config. The caller owns them.
+inline std::vector<std::pair<std::string, Format*>> makeFormats(const Base256Config& config) {
+  std::vector<std::pair<std::string, Format*>> formats;
+  formats.push_back({"cp437", new CP437(config.printnewline, config.printnull, config.comma)});
+  formats.push_back({"cp1252", new CP1252(config.printnewline, config.printnull, config.comma)});
+  formats.push_back({"braille", new Braille(config.printnewline, config.printnull, config.comma)});
+  formats.push_back({"ascii", new ASCII(config.printnewline)});
+  formats.push_back({"base64", new Base64});
+  formats.push_back({"hex", new Hex(config.prefix, config.lower)});
+  formats.push_back({"dec", new Decimal(config.prefix)});
+  formats.push_back({"oct", new Octal(config.prefix)});
+  formats.push_back({"bin", new Binary(config.lsb_first, config.prefix)});
+  formats.push_back({"low", new Low(config.printnewline, config.lower)});
+  formats.push_back({"high", new High(config.printnewline, config.lower)});
+  formats.push_back({"colored", new Colored()});
+  formats.push_back({"c", new CString()});
+  formats.push_back({"cpp", new CPPString()});
+  formats.push_back({"java", new JavaString()});
+  formats.push_back({"js", new JSString()});
+  formats.push_back({"json", new JSONString()});
+  formats.push_back({"python", new PythonString()});
+  return formats;
+}
+
+// Encodes and decodes in-process, into buffers of the caller. The format,
+// its byte table and a work buffer are made by the constructor, after which
+// encode and decode don't allocate memory per byte or per call: they work in
+// chunks through the work buffer, whose capacity is kept. Not thread safe,
+// use one per thread.
+class Base256Codec {
+ public:
+  explicit Base256Codec(const Base256Config& config) : formats(makeFormats(config)) {
+    for(size_t i = 0; i < formats.size(); i++) {
+      if(formats[i].first == config.format) printer = new Printer(formats[i].second);
+    }
+    if(!printer) return;
+    printer->configure(config);
+    printer->begin(); // builds the table
+    buffer.reserve(CHUNK_SIZE * 64);
+  }
+
+  ~Base256Codec() {
+    delete printer;
+    for(size_t i = 0; i < formats.size(); i++) delete formats[i].second;
+  }
+
+  Base256Codec(const Base256Codec&) = delete;
+  Base256Codec& operator=(const Base256Codec&) = delete;
+
+  // false if the format name of the config is unknown
+  bool valid() const {
+    return printer != 0;
+  }
+
+  // the exact size that encode gives for the input
+  size_t encodedSize(const char* in, size_t size) {
+    printer->totalsize = size;
+    printer->begin();
+    return printer->encodedSize(in, size);
+  }
+
+  // Encodes the input into out, which has room for outsize bytes. Returns the
+  // size of the whole output, like snprintf: if that is more than outsize,
+  // the output was cut off.
+  size_t encode(const char* in, size_t size, char* out, size_t outsize) {
+    printer->totalsize = size;
+    printer->begin();
+    size_t pos = 0;
+    for(size_t i = 0; i < size; i += CHUNK_SIZE) {
+      printer->feed(in + i, std::min(CHUNK_SIZE, size - i), &buffer);
+      pos = put(out, outsize, pos);
+    }
+    printer->finish(&buffer);
+    return put(out, outsize, pos);
+  }
+
+  // Decodes the text into out, like encode. Every character decodes to at
+  // most one byte, and invalid ones to a '?' or nothing, so outsize = size is
+  // always enough. Nothing is printed: what is wrong with the text, such as
+  // invalid characters or a format that can't decode, is given by errors and
+  // messages.
+  size_t decode(const char* in, size_t size, char* out, size_t outsize) {
+    printer->decodeBegin();
+    size_t pos = 0;
+    for(size_t i = 0; i < size; i += CHUNK_SIZE) {
+      printer->decodeFeed(in + i, std::min(CHUNK_SIZE, size - i), &buffer);
+      pos = put(out, outsize, pos);
+    }
+    printer->decodeFinish(&buffer);
+    diagnostics = printer->takeMessages();
+    return put(out, outsize, pos);
+  }
+
+  // the amount of problems the last decode found, 0 if the text was valid
+  size_t errors() const {
+    return std::count(diagnostics.begin(), diagnostics.end(), '\n');
+  }
+
+  // the problems the last decode found, a line each
+  const std::string& messages() const {
+    return diagnostics;
+  }
+
+ private:
+  // input bytes per chunk, small enough that its output fits the buffer
+  static const size_t CHUNK_SIZE = 16384;
+
+  // moves the buffer to out at pos, as far as it fits, returns the new pos
+  size_t put(char* out, size_t outsize, size_t pos) {
+    if(pos < outsize) memcpy(out + pos, buffer.data(), std::min(buffer.size(), outsize - pos));
+    pos += buffer.size();
+    buffer.clear();
+    return pos;
+  }
+
+  std::vector<std::pair<std::string, Format*>> formats;
+  Printer* printer = 0;
+  std::string buffer; // output of a chunk
+  std::string diagnostics; // messages of the last decode
+};
+
+#endif
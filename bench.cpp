@@ -0,0 +1,263 @@
+/*
+base256
+
+Copyright (c) 2019, Lode Vandevenne
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Throughput benchmark of the formats: encodes and decodes synthetic inputs
+// with every format and a few option combinations, and prints the results as
+// comma separated values, one line per measurement. Both directions are in
+// MB/s of binary data. Decoding is only measured where the encoded text
+// decodes back to the input.
+//
+// usage: base256_bench [sizes...] [--format=name...] [--kernel=name]
+// with sizes like 4K, 1M or 1G, by default 4K 1M 16M, and by default the
+// best SIMD kernel that the CPU supports.
+
+#include "base256.h"
+
+#include <chrono>
+
+// the largest input that is really made, bigger sizes loop over it
+static const size_t SAMPLE_SIZE = 8 * 1048576;
+
+// spend at least this many seconds per measurement, repeating small inputs
+static const double MIN_TIME = 0.1;
+
+struct Options {
+  const char* name;
+  bool mix;
+  bool colored;
+  bool comma;
+  int wrap;
+  bool printlinenumbers;
+};
+
+static const Options OPTIONS[] = {
+  {"none", false, false, false, 0, false},
+  {"--mix", true, false, false, 0, false},
+  {"--color", false, true, false, 0, false},
+  {"--comma", false, false, true, 0, false},
+  {"-w", false, false, false, 64, false},
+  {"-w -l", false, false, false, 64, true},
+};
+
+// xorshift, so that the inputs are the same every run
+struct Random {
+  uint64_t s = 88172645463325252ull;
+  uint64_t next() {
+    s ^= s << 13;
+    s ^= s >> 7;
+    s ^= s << 17;
+    return s;
+  }
+};
+
+static std::string makeRandom(size_t size) {
+  Random r;
+  std::string result(size, 0);
+  for(size_t i = 0; i < size; i++) result[i] = r.next() >> 32;
+  return result;
+}
+
+static std::string makeZero(size_t size) {
+  return std::string(size, 0);
+}
+
+// words, punctuation and newlines
+static std::string makeText(size_t size) {
+  static const char* const words[] = {"the", "of", "base256", "glyph", "format", "and", "a", "byte",
+      "printer", "to", "in", "table", "encode", "is", "newline", "with"};
+  Random r;
+  std::string result;
+  while(result.size() < size) {
+    uint64_t v = r.next();
+    result += words[v & 15];
+    result += ((v >> 4) & 15) == 0 ? ".\n" : ((v >> 8) & 7) == 0 ? ", " : " ";
+  }
+  result.resize(size);
+  return result;
+}
+
+// like an executable: a header, code of random bytes with many small values,
+// zero padding, string tables and small integers in tables
+static std::string makeElf(size_t size) {
+  Random r;
+  std::string result("\x7f" "ELF\x02\x01\x01", 7);
+  result.resize(64, 0);
+  while(result.size() < size) {
+    uint64_t v = r.next();
+    size_t len = 64 + (v & 1023);
+    switch((v >> 10) & 3) {
+      case 0:
+        for(size_t i = 0; i < len; i++) {
+          uint64_t b = r.next();
+          result += (char)((b & 3) == 0 ? (b >> 8) & 15 : b >> 16);
+        }
+        break;
+      case 1:
+        result.append(len, 0);
+        break;
+      case 2:
+        result += makeText(len);
+        result += '\0';
+        break;
+      default:
+        for(size_t i = 0; i < len; i += 8) {
+          uint64_t b = r.next() & 4095;
+          result.append((const char*)&b, 8);
+        }
+    }
+  }
+  result.resize(size);
+  return result;
+}
+
+static double now() {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// parses a size like 4K, 1M or 1G
+static size_t parseSize(const std::string& s) {
+  size_t result = strtoval<size_t>(s);
+  char unit = s.empty() ? 0 : s[s.size() - 1];
+  if(unit == 'K' || unit == 'k') result <<= 10;
+  if(unit == 'M' || unit == 'm') result <<= 20;
+  if(unit == 'G' || unit == 'g') result <<= 30;
+  return result;
+}
+
+// Encodes size bytes, taken from the sample in a loop, the way the command
+// line tool streams: block by block, with an output buffer that's reused.
+// Returns the seconds it took.
+static double encodeStream(Printer* printer, const std::string& sample, size_t size, std::string* out) {
+  double start = now();
+  printer->totalsize = size;
+  printer->begin();
+  size_t done = 0;
+  while(done < size) {
+    size_t pos = done % sample.size();
+    size_t n = std::min(std::min(BLOCK_SIZE, size - done), sample.size() - pos);
+    printer->feed(sample.data() + pos, n, out);
+    out->clear();
+    done += n;
+  }
+  printer->finish(out);
+  out->clear();
+  return now() - start;
+}
+
+// decodes the text, the encoded sample, as many times as needed for size
+// bytes of output
+static double decodeStream(Printer* printer, const std::string& text, size_t samplesize, size_t size, std::string* out) {
+  double start = now();
+  for(size_t done = 0; done < size; done += samplesize) {
+    printer->decodeBegin();
+    for(size_t i = 0; i < text.size(); i += BLOCK_SIZE) {
+      printer->decodeFeed(text.data() + i, std::min(BLOCK_SIZE, text.size() - i), out);
+      out->clear();
+    }
+    printer->decodeFinish(out);
+    out->clear();
+  }
+  return now() - start;
+}
+
+// repeats measure until it took MIN_TIME in total, returns MB/s
+template<typename F>
+static double throughput(size_t size, const F& measure) {
+  double total = 0;
+  size_t count = 0;
+  do {
+    total += measure();
+    count++;
+  } while(total < MIN_TIME);
+  return size * count / total / 1e6;
+}
+
+int main(int argc, char *argv[]) {
+  std::vector<size_t> sizes;
+  std::set<std::string> only;
+  for(int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if(arg.compare(0, 9, "--format=") == 0) {
+      only.insert(arg.substr(9));
+    } else if(arg.compare(0, 9, "--kernel=") == 0) {
+      if(!set_kernel(arg.substr(9))) {
+        std::cout << "unknown kernel, or not supported by this CPU: " << arg.substr(9) << std::endl;
+        return 1;
+      }
+    } else {
+      sizes.push_back(parseSize(arg));
+    }
+  }
+  if(sizes.empty()) sizes = {4096, 1048576, 16 * 1048576};
+
+  std::vector<std::pair<std::string, std::string (*)(size_t)>> corpora = {
+    {"random", makeRandom}, {"zero", makeZero}, {"text", makeText}, {"elf", makeElf}
+  };
+
+  std::cout << "kernel,format,options,corpus,size,direction,mbps" << std::endl;
+  std::string kernel = std::string(KERNEL_NAMES[simd_kernel()]) + ",";
+  std::string out;
+  for(size_t c = 0; c < corpora.size(); c++) {
+    for(size_t s = 0; s < sizes.size(); s++) {
+      size_t size = sizes[s];
+      std::string sample = corpora[c].second(std::min(size, SAMPLE_SIZE));
+      for(const Options& options : OPTIONS) {
+        Base256Config config;
+        config.mix = options.mix;
+        config.colored = options.colored;
+        config.comma = options.comma;
+        config.wrap = options.wrap;
+        config.printlinenumbers = options.printlinenumbers;
+        std::vector<std::pair<std::string, Format*>> formats = makeFormats(config);
+        for(size_t f = 0; f < formats.size(); f++) {
+          const std::string& name = formats[f].first;
+          if(!only.empty() && !only.count(name)) continue;
+          config.format = name;
+          Printer printer(formats[f].second);
+          printer.configure(config);
+
+          double encode = throughput(size, [&]() { return encodeStream(&printer, sample, size, &out); });
+          std::cout << kernel << name << "," << options.name << "," << corpora[c].first << "," << size << ",encode," << encode << std::endl;
+
+          // decode the encoded sample, if the format can decode it back
+          printer.totalsize = sample.size();
+          std::string text = printer.encode(sample);
+          printer.decodeBegin();
+          std::string back;
+          printer.decodeFeed(text.data(), text.size(), &back);
+          printer.decodeFinish(&back);
+          if(back != sample) continue;
+          double decode = throughput(size, [&]() { return decodeStream(&printer, text, sample.size(), size, &out); });
+          std::cout << kernel << name << "," << options.name << "," << corpora[c].first << "," << size << ",decode," << decode << std::endl;
+        }
+        for(size_t f = 0; f < formats.size(); f++) delete formats[f].second;
+      }
+    }
+  }
+  return 0;
+}
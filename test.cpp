@@ -0,0 +1,394 @@
+/*
+base256
+
+Copyright (c) 2019, Lode Vandevenne
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Differential test of the fast encode paths (byte table, SIMD pattern
+// encoder, block encoding, threaded parts, the codec) against the reference:
+// the Printer encoding byte by byte with Format::encodeChar, as it does for
+// formats without a table. Runs every format with combinations of the options
+// on random and adversarial inputs, and checks that the formats that can
+// decode give the input back. Prints the first differing byte of every
+// failure, and returns 1 if there was any.
+//
+// usage: base256_test [--format=name...] [--kernel=name...]
+// by default with every SIMD kernel that the CPU supports.
+
+#include "base256.h"
+
+// xorshift, so that the inputs are the same every run
+struct Random {
+  uint64_t s = 88172645463325252ull;
+  uint64_t next() {
+    s ^= s << 13;
+    s ^= s >> 7;
+    s ^= s << 17;
+    return s;
+  }
+};
+
+struct Input {
+  std::string name;
+  std::string data;
+};
+
+// random bytes from the given alphabet, or all values if empty
+static std::string makeRandom(Random* r, size_t size, const std::string& alphabet) {
+  std::string result(size, 0);
+  for(size_t i = 0; i < size; i++) {
+    uint64_t v = r->next() >> 32;
+    result[i] = alphabet.empty() ? v : alphabet[v % alphabet.size()];
+  }
+  return result;
+}
+
+// Inputs that are likely to find differences: sizes around the SIMD widths
+// and wrap widths, runs of printable bytes broken up by other bytes,
+// newlines, spaces, nulls, escapes and quotes for the strings, and UTF-8 like
+// sequences.
+static std::vector<Input> makeInputs() {
+  Random r;
+  std::vector<Input> inputs;
+  inputs.push_back({"empty", ""});
+  std::string all(256, 0);
+  for(int c = 0; c < 256; c++) all[c] = c;
+  inputs.push_back({"all", all});
+  inputs.push_back({"reverse", std::string(all.rbegin(), all.rend())});
+  static const size_t sizes[] = {1, 2, 3, 7, 15, 16, 17, 31, 32, 33, 63, 64, 65, 100, 1000};
+  for(size_t size : sizes) {
+    inputs.push_back({"random" + valtostr(size), makeRandom(&r, size, "")});
+  }
+  std::string special("\0\n\r\t \"'\\?\x7f\x80\xff\xe2\x94\x80", 15);
+  inputs.push_back({"special", makeRandom(&r, 1000, special)});
+  inputs.push_back({"newlines", makeRandom(&r, 300, std::string("\n\n\na", 4))});
+  inputs.push_back({"zero", std::string(500, 0)});
+  inputs.push_back({"spaces", std::string(100, ' ')});
+  // printable runs of every length up to 70, between non printable bytes
+  std::string runs;
+  for(size_t len = 0; len <= 70; len++) {
+    runs += makeRandom(&r, len, "abcdefghijklmnopqrstuvwxyz0123456789 !~,.");
+    runs += (char)(r.next() & 31);
+  }
+  inputs.push_back({"runs", runs});
+  std::string text;
+  while(text.size() < 2000) {
+    text += makeRandom(&r, 1 + r.next() % 12, "etaoinshrdlu");
+    text += (r.next() & 7) == 0 ? "\n" : " ";
+  }
+  inputs.push_back({"text", text});
+  // valid and cut off UTF-8
+  std::string utf8;
+  while(utf8.size() < 1000) {
+    static const char* const seqs[] = {"\xc3\xa9", "\xe2\x82\xac", "\xf0\x9f\x98\x80", "\xe2\x82", "\xc3", "x"};
+    utf8 += seqs[r.next() % 6];
+  }
+  inputs.push_back({"utf8", utf8});
+  return inputs;
+}
+
+static const char* const FLAGS[] = {"--mix", "--printspace", "--printnewline", "--printnull", "--comma", "--color"};
+
+// the options of combination k: every combination of the flags with every
+// wrap width, with the line numbers cycled through
+static Base256Config makeConfig(size_t k, std::string* name) {
+  static const int wraps[] = {0, 1, 5, 16};
+  Base256Config config;
+  config.mix = k & 1;
+  config.printspace = k & 2;
+  config.printnewline = k & 4;
+  config.printnull = k & 8;
+  config.comma = k & 16;
+  config.colored = k & 32;
+  config.prefix = k & 64;
+  config.wrap = wraps[k >> 7];
+  config.printlinenumbers = k % 3 != 0;
+  config.linenumbersbase = k % 3 == 2 ? 16 : 10;
+  *name = "";
+  for(size_t i = 0; i < 6; i++) {
+    if(k & (1 << i)) *name += std::string(FLAGS[i]) + " ";
+  }
+  if(config.prefix) *name += "--prefix ";
+  if(config.wrap) *name += "--wrap=" + valtostr(config.wrap) + " ";
+  if(config.printlinenumbers) *name += config.linenumbersbase == 16 ? "-L " : "-l ";
+  if(!name->empty()) name->resize(name->size() - 1);
+  return config;
+}
+
+// whether the encoded text is supposed to decode back to the input, see the
+// limitations in the help of --decode and of --mix
+static bool roundTrips(const std::string& format, const Base256Config& config) {
+  static const char* const decodable[] = {"cp437", "cp1252", "braille", "base64", "hex", "dec", "bin",
+      "c", "cpp", "java", "js", "json", "python"};
+  bool found = false;
+  for(const char* name : decodable) found = found || format == name;
+  // these change the glyphs to ones the decoder doesn't know
+  if(!found || config.printnewline || config.printnull || config.printspace) return false;
+  // in mix mode, the printable characters run together with the values of
+  // base64 and braille, and look like values of dec with prefix
+  if(config.mix && (format == "base64" || format == "braille" || (format == "dec" && config.prefix))) return false;
+  // JSON strings can't have newlines, so the line numbers are inside the string
+  if(format == "json" && config.wrap && config.printlinenumbers) return false;
+  return true;
+}
+
+static size_t numchecks = 0;
+static size_t numfailures = 0;
+
+// the bytes of s with the non printable ones as hex escapes
+static std::string show(const std::string& s) {
+  std::string result;
+  for(size_t i = 0; i < s.size(); i++) {
+    unsigned char c = s[i];
+    if(c >= 32 && c < 127 && c != '\\') {
+      result += c;
+    } else {
+      result += "\\x";
+      result += "0123456789abcdef"[c >> 4];
+      result += "0123456789abcdef"[c & 15];
+    }
+  }
+  return result;
+}
+
+// compares the output of a fast path with the expected one, prints where they
+// first differ
+static bool check(const std::string& what, const std::string& expected, const std::string& got) {
+  numchecks++;
+  if(expected == got) return true;
+  size_t pos = 0;
+  while(pos < expected.size() && pos < got.size() && expected[pos] == got[pos]) pos++;
+  size_t from = pos < 16 ? 0 : pos - 16;
+  std::cout << "FAIL " << what << ": first difference at byte " << pos << " of " << expected.size()
+            << " expected, " << got.size() << " got" << std::endl;
+  std::cout << "  expected: " << show(expected.substr(from, 48)) << std::endl;
+  std::cout << "  got:      " << show(got.substr(from, 48)) << std::endl;
+  numfailures++;
+  return false;
+}
+
+// encodes byte by byte with Format::encodeChar, without the byte table or
+// block encoding
+static std::string encodeReference(Printer* printer, const std::string& in) {
+  std::string result;
+  printer->reference = true;
+  printer->totalsize = in.size();
+  printer->begin();
+  printer->feed(in.data(), in.size(), &result);
+  printer->finish(&result);
+  printer->reference = false;
+  return result;
+}
+
+// encodes in parts of random sizes
+static std::string encodeChunked(Printer* printer, const std::string& in, Random* r) {
+  std::string result;
+  printer->totalsize = in.size();
+  printer->begin();
+  for(size_t i = 0; i < in.size();) {
+    size_t size = std::min<size_t>(in.size() - i, 1 + r->next() % 300);
+    printer->feed(in.data() + i, size, &result);
+    i += size;
+  }
+  printer->finish(&result);
+  return result;
+}
+
+// encodes in parts the way encodeThreaded splits the input, but with small
+// parts
+static std::string encodeParts(Printer* printer, const std::string& in) {
+  std::string result;
+  printer->totalsize = in.size();
+  printer->begin();
+  size_t align = printer->n->groupsize() * (printer->wrap > 0 ? printer->wrap : 1);
+  size_t partsize = (100 + align - 1) / align * align;
+  size_t begin = 0;
+  do {
+    size_t end = std::min(in.size(), begin + partsize);
+    printer->encodePart(in.data(), begin, end, &result);
+    begin = end;
+  } while(begin < in.size());
+  return result;
+}
+
+static std::string decodeChunked(Printer* printer, const std::string& text, Random* r) {
+  std::string result;
+  printer->decodeBegin();
+  for(size_t i = 0; i < text.size();) {
+    size_t size = std::min<size_t>(text.size() - i, 1 + r->next() % 300);
+    printer->decodeFeed(text.data() + i, size, &result);
+    i += size;
+  }
+  printer->decodeFinish(&result);
+  return result;
+}
+
+// the text with some of its characters replaced by random ones
+static std::string damage(const std::string& text, Random* r) {
+  std::string result = text;
+  for(size_t i = r->next() % 50; i < result.size(); i += 1 + r->next() % 100) result[i] = r->next() >> 32;
+  return result;
+}
+
+// decodes the whole text, giving the diagnostics in *messages
+static std::string decodeMessages(Printer* printer, const std::string& text, std::string* messages) {
+  std::string result = printer->decode(text);
+  *messages = printer->takeMessages();
+  return result;
+}
+
+// Decodes with threads, in parts of as few as 64 characters so that the small
+// inputs are split. The output of such an input stays in the buffer of the
+// OutputFile, which is never opened. Gives the diagnostics in *messages.
+static std::string decodeThreaded(Printer* printer, const std::string& text, std::string* messages) {
+  OutputFile out;
+  std::ostringstream stream;
+  size_t minpartsize = printer->minpartsize;
+  printer->minpartsize = 64;
+  printer->decodeThreaded(text.data(), text.size(), 4, &out, &stream);
+  printer->minpartsize = minpartsize;
+  std::string result;
+  result.swap(out.buffer);
+  *messages = stream.str();
+  return result;
+}
+
+static std::string codecEncode(Base256Codec* codec, const std::string& in) {
+  std::string result(codec->encodedSize(in.data(), in.size()), 0);
+  size_t size = codec->encode(in.data(), in.size(), &result[0], result.size());
+  result.resize(size);
+  return result;
+}
+
+static std::string codecDecode(Base256Codec* codec, const std::string& text) {
+  std::string result(text.size(), 0);
+  result.resize(codec->decode(text.data(), text.size(), &result[0], result.size()));
+  return result;
+}
+
+// checks the fast paths for the input against the expected output of the
+// reference, with the current kernel
+static void checkInput(Printer* printer, Base256Codec* codec, const Base256Config& config, const std::string& what,
+                       const std::string& in, const std::string& expected, Random* r) {
+  check(what + " encode", expected, printer->encode(in));
+  check(what + " chunked encode", expected, encodeChunked(printer, in, r));
+  if(!printer->n->outwidth() || config.wrap <= 0) {
+    check(what + " encode in parts", expected, encodeParts(printer, in));
+  }
+  check(what + " codec encode", expected, codecEncode(codec, in));
+  numchecks++;
+  printer->totalsize = in.size();
+  printer->begin();
+  size_t size = printer->encodedSize(in.data(), in.size());
+  if(size != expected.size()) {
+    std::cout << "FAIL " << what << " encodedSize: " << size << " instead of " << expected.size() << std::endl;
+    numfailures++;
+  }
+  if(!roundTrips(config.format, config)) return;
+  std::string messages;
+  check(what + " decode", in, decodeMessages(printer, expected, &messages));
+  check(what + " decode messages", "", messages);
+  check(what + " chunked decode", in, decodeChunked(printer, expected, r));
+  if(config.comma) {
+    check(what + " threaded decode", in, decodeThreaded(printer, expected, &messages));
+    check(what + " threaded decode messages", "", messages);
+  }
+  check(what + " codec decode", in, codecDecode(codec, expected));
+  check(what + " codec decode messages", "", codec->messages());
+}
+
+int main(int argc, char *argv[]) {
+  std::set<std::string> only;
+  std::vector<std::string> kernels; // by default all that the CPU supports
+  for(int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if(arg.compare(0, 9, "--format=") == 0) only.insert(arg.substr(9));
+    if(arg.compare(0, 9, "--kernel=") == 0) kernels.push_back(arg.substr(9));
+  }
+  if(kernels.empty()) {
+    for(int k = 0; k <= detect_kernel(); k++) kernels.push_back(KERNEL_NAMES[k]);
+  }
+  for(size_t i = 0; i < kernels.size(); i++) {
+    if(!set_kernel(kernels[i])) {
+      std::cout << "unknown kernel, or not supported by this CPU: " << kernels[i] << std::endl;
+      return 1;
+    }
+  }
+
+  // a format that can't decode says so, rather than writing the reason to
+  // the output
+  {
+    Base256Config config;
+    config.printnewline = true;
+    Base256Codec codec(config);
+    check("codec decode with printnewline", "", codecDecode(&codec, "abc"));
+    numchecks++;
+    if(codec.errors() != 1) {
+      std::cout << "FAIL codec decode with printnewline: " << codec.errors() << " errors instead of 1" << std::endl;
+      numfailures++;
+    }
+  }
+
+  std::vector<Input> inputs = makeInputs();
+  Random r;
+  for(size_t k = 0; k < 512; k++) {
+    std::string options;
+    Base256Config config = makeConfig(k, &options);
+    std::vector<std::pair<std::string, Format*>> formats = makeFormats(config);
+    for(size_t f = 0; f < formats.size(); f++) {
+      const std::string& name = formats[f].first;
+      if(!only.empty() && !only.count(name)) continue;
+      config.format = name;
+      Printer printer(formats[f].second);
+      printer.configure(config);
+      Base256Codec codec(config);
+      for(const Input& input : inputs) {
+        std::string expected = encodeReference(&printer, input.data);
+        // damaged text must decode the same with every kernel as without SIMD
+        std::string damaged = damage(expected, &r);
+        set_kernel("scalar");
+        std::string scalarmessages;
+        std::string scalardecode = roundTrips(name, config) ? decodeMessages(&printer, damaged, &scalarmessages) : "";
+        for(size_t i = 0; i < kernels.size(); i++) {
+          set_kernel(kernels[i]);
+          std::string what = name + " [" + options + "] " + input.name + " (" + kernels[i] + ")";
+          checkInput(&printer, &codec, config, what, input.data, expected, &r);
+          if(roundTrips(name, config)) {
+            std::string messages;
+            check(what + " damaged decode", scalardecode, decodeMessages(&printer, damaged, &messages));
+            check(what + " damaged decode messages", scalarmessages, messages);
+            // the parts give the positions of the messages in the whole text
+            check(what + " damaged threaded decode", scalardecode, decodeThreaded(&printer, damaged, &messages));
+            check(what + " damaged threaded decode messages", scalarmessages, messages);
+          }
+        }
+      }
+    }
+    for(size_t f = 0; f < formats.size(); f++) delete formats[f].second;
+  }
+
+  std::cout << numchecks << " checks, " << numfailures << " failures" << std::endl;
+  return numfailures ? 1 : 0;
+}